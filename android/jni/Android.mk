@@ -31,6 +31,9 @@ LOCAL_SRC_FILES := main.cpp \
                    ../../tests/test.cpp \
                    ../../src/idl_parser.cpp \
                    ../../src/idl_gen_text.cpp \
+                   ../../src/idl_gen_csv.cpp \
+                   ../../src/idl_json_lines.cpp \
+                   ../../src/idl_schema_cache.cpp \
                    ../../src/idl_gen_fbs.cpp \
                    ../../src/idl_gen_general.cpp \
                    ../../src/reflection.cpp
@@ -305,7 +305,8 @@ public:
   void MutateOffset(uoffset_t i, const uint8_t *val) {
     assert(i < size());
     assert(sizeof(T) == sizeof(uoffset_t));
-    WriteScalar(data() + i, val - (Data() + i * sizeof(uoffset_t)));
+    WriteScalar(data() + i,
+      static_cast<uoffset_t>(val - (Data() + i * sizeof(uoffset_t))));
   }
 
   // The raw data in little endian format. Use with care.
@@ -1068,7 +1069,8 @@ class Table {
   bool SetPointer(voffset_t field, const uint8_t *val) {
     auto field_offset = GetOptionalFieldOffset(field);
     if (!field_offset) return false;
-    WriteScalar(data_ + field_offset, val - (data_ + field_offset));
+    WriteScalar(data_ + field_offset,
+                static_cast<uoffset_t>(val - (data_ + field_offset)));
     return true;
   }
 
@@ -1081,6 +1083,9 @@ class Table {
   }
 
   uint8_t *GetVTable() { return data_ - ReadScalar<soffset_t>(data_); }
+  const uint8_t *GetVTable() const {
+    return data_ - ReadScalar<soffset_t>(data_);
+  }
 
   bool CheckField(voffset_t field) const {
     return GetOptionalFieldOffset(field) != 0;
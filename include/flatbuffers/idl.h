@@ -21,7 +21,12 @@
 #include <set>
 #include <stack>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <utility>
 #include <functional>
+#include <cstdio>
 
 #include "flatbuffers/flatbuffers.h"
 #include "flatbuffers/hash.h"
@@ -145,31 +150,142 @@ struct Value {
   voffset_t offset;
 };
 
-// Helper class that retains the original order of a set of identifiers and
-// also provides quick lookup.
-template<typename T> class SymbolTable {
+// A scalar parsed from JSON data, in binary form: integers (and offsets of
+// objects already serialized) as int64_t, floating point values as double.
+// Unlike Value, used for the schema, this never needs a string.
+union ScalarValue {
+  int64_t i;
+  double f;
+};
+
+// Allocates objects (the definitions of a Parser) from large blocks rather
+// than one at a time, and destroys them all at once along with itself.
+class DefinitionArena {
  public:
-  ~SymbolTable() {
-    for (auto it = vec.begin(); it != vec.end(); ++it) {
-      delete *it;
+  DefinitionArena() : objects_(nullptr), blocks_(nullptr), cur_(nullptr),
+                      left_(0) {}
+
+  ~DefinitionArena() {
+    for (auto obj = objects_; obj; obj = obj->prev) obj->destroy(obj + 1);
+    while (blocks_) {
+      auto prev = blocks_->prev;
+      delete[] reinterpret_cast<char *>(blocks_);
+      blocks_ = prev;
     }
   }
 
+  template<typename T, typename... Args> T *New(Args &&...args) {
+    static_assert(alignof(T) <= sizeof(ObjectHeader),
+                  "type needs more alignment than the arena provides");
+    auto header = reinterpret_cast<ObjectHeader *>(
+                    Allocate(sizeof(ObjectHeader) + sizeof(T)));
+    auto obj = new (header + 1) T(std::forward<Args>(args)...);
+    header->destroy = Destroy<T>;
+    header->prev = objects_;
+    objects_ = header;
+    return obj;
+  }
+
+ private:
+  DefinitionArena(const DefinitionArena &);
+  DefinitionArena &operator=(const DefinitionArena &);
+
+  // Precedes every object, also aligning it.
+  struct ObjectHeader {
+    void (*destroy)(void *);
+    ObjectHeader *prev;  // Allocated before this one.
+  };
+  struct BlockHeader {
+    BlockHeader *prev;
+    void *pad;
+  };
+  static const size_t kBlockSize = 1 << 16;
+
+  template<typename T> static void Destroy(void *obj) {
+    static_cast<T *>(obj)->~T();
+  }
+
+  char *Allocate(size_t size) {
+    size = (size + sizeof(ObjectHeader) - 1) & ~(sizeof(ObjectHeader) - 1);
+    if (size > left_) {
+      // Large objects get a block of their own, leaving the current one be.
+      auto own_block = size > kBlockSize / 4;
+      auto block_size = own_block ? size : kBlockSize;
+      auto block = reinterpret_cast<BlockHeader *>(
+                     new char[sizeof(BlockHeader) + block_size]);
+      block->prev = blocks_;
+      blocks_ = block;
+      if (own_block) return reinterpret_cast<char *>(block + 1);
+      cur_ = reinterpret_cast<char *>(block + 1);
+      left_ = block_size;
+    }
+    auto mem = cur_;
+    cur_ += size;
+    left_ -= size;
+    return mem;
+  }
+
+  ObjectHeader *objects_;
+  BlockHeader *blocks_;
+  char *cur_;
+  size_t left_;
+};
+
+// Helper class that retains the original order of a set of identifiers and
+// also provides quick lookup. It doesn't own the objects it refers to, which
+// are typically allocated from a DefinitionArena.
+template<typename T> class SymbolTable {
+ public:
   bool Add(const std::string &name, T *e) {
     vec.emplace_back(e);
-    auto it = dict.find(name);
-    if (it != dict.end()) return true;
-    dict[name] = e;
+    if (!dict.insert(std::make_pair(name, e)).second) return true;
+    index.clear();
     return false;
   }
 
   T *Lookup(const std::string &name) const {
+    if (index.size()) {
+      auto hash = HashFnv1a<uint32_t>(name.c_str());
+      auto mask = index.size() - 1;
+      for (auto i = hash & mask; index[i].key; i = (i + 1) & mask) {
+        if (index[i].hash == hash && *index[i].key == name)
+          return index[i].value;
+      }
+      return nullptr;
+    }
     auto it = dict.find(name);
     return it == dict.end() ? nullptr : it->second;
   }
 
+  // Builds a hash table of all names, which Lookup() uses instead of
+  // comparing strings down the map, until the next Add().
+  // Not thread safe, so should be called once all symbols are added.
+  void BuildIndex() {
+    size_t size = 4;
+    while (size < dict.size() * 2) size *= 2;  // At most half full.
+    index.assign(size, IndexEntry());
+    for (auto it = dict.begin(); it != dict.end(); ++it) {
+      auto hash = HashFnv1a<uint32_t>(it->first.c_str());
+      auto i = hash & (size - 1);
+      while (index[i].key) i = (i + 1) & (size - 1);
+      index[i].hash = hash;
+      index[i].key = &it->first;
+      index[i].value = it->second;
+    }
+  }
+
+  bool HasIndex() const { return index.size() != 0; }
+
  private:
+  struct IndexEntry {
+    IndexEntry() : hash(0), key(nullptr), value(nullptr) {}
+    uint32_t hash;
+    const std::string *key;  // Points into dict, nullptr if unused.
+    T *value;
+  };
+
   std::map<std::string, T *> dict;      // quick lookup
+  std::vector<IndexEntry> index;  // quicker lookup, see BuildIndex()
 
  public:
   std::vector<T *> vec;  // Used to iterate in order of insertion
@@ -198,8 +314,7 @@ struct Definition {
 };
 
 struct FieldDef : public Definition {
-  FieldDef() : deprecated(false), required(false), key(false), padding(0),
-               used(false) {}
+  FieldDef() : deprecated(false), required(false), key(false), padding(0) {}
 
   Offset<reflection::Field> Serialize(FlatBufferBuilder *builder, uint16_t id)
                                                                           const;
@@ -210,7 +325,6 @@ struct FieldDef : public Definition {
   bool required;   // Field must always be present.
   bool key;        // Field functions as a key for creating sorted vectors.
   size_t padding;  // Bytes to always pad after this field.
-  bool used;       // Used during JSON parsing to check for repeated fields.
 };
 
 struct StructDef : public Definition {
@@ -238,6 +352,12 @@ struct StructDef : public Definition {
   bool has_key;     // It has a key field.
   size_t minalign;  // What the whole object needs to be aligned to.
   size_t bytesize;  // Size if fixed.
+
+  // How to generate text for this struct, worked out by the text generator
+  // the first time it is needed, and shared by all documents after that.
+  struct TextPlan;
+  mutable std::shared_ptr<const TextPlan> text_plan;
+  mutable std::once_flag text_plan_once;
 };
 
 inline bool IsStruct(const Type &type) {
@@ -265,12 +385,29 @@ struct EnumVal {
 };
 
 struct EnumDef : public Definition {
-  EnumDef() : is_union(false) {}
-
-  EnumVal *ReverseLookup(int enum_idx, bool skip_union_default = true) {
-    for (auto it = vals.vec.begin() + static_cast<int>(is_union &&
-                                                       skip_union_default);
-             it != vals.vec.end(); ++it) {
+  EnumDef() : is_union(false), indexed_vals_(0), min_value_(0) {}
+
+  EnumVal *ReverseLookup(int enum_idx, bool skip_union_default = true) const {
+    auto skip = static_cast<size_t>(is_union && skip_union_default);
+    if (HasReverseIndex()) {
+      EnumVal *ev = nullptr;
+      if (dense_index_.size()) {
+        auto i = static_cast<uint64_t>(enum_idx - min_value_);
+        if (enum_idx >= min_value_ && i < dense_index_.size())
+          ev = dense_index_[static_cast<size_t>(i)];
+      } else {
+        auto mask = hashed_index_.size() - 1;
+        for (auto i = HashValue(enum_idx) & mask; hashed_index_[i];
+             i = (i + 1) & mask) {
+          if (hashed_index_[i]->value == enum_idx) {
+            ev = hashed_index_[i];
+            break;
+          }
+        }
+      }
+      return skip && ev == vals.vec[0] ? nullptr : ev;
+    }
+    for (auto it = vals.vec.begin() + skip; it != vals.vec.end(); ++it) {
       if ((*it)->value == enum_idx) {
         return *it;
       }
@@ -278,11 +415,62 @@ struct EnumDef : public Definition {
     return nullptr;
   }
 
+  // Builds a table of all values, which ReverseLookup() uses instead of
+  // scanning them, until values are added: indexed by value if they're
+  // dense enough, hashed otherwise.
+  // Not thread safe, so should be called once all values are added.
+  void BuildReverseIndex() {
+    dense_index_.clear();
+    hashed_index_.clear();
+    indexed_vals_ = vals.vec.size();
+    if (!indexed_vals_) return;
+    min_value_ = vals.vec.front()->value;
+    auto max_value = min_value_;
+    for (auto it = vals.vec.begin(); it != vals.vec.end(); ++it) {
+      min_value_ = std::min(min_value_, (*it)->value);
+      max_value = std::max(max_value, (*it)->value);
+    }
+    // Values are in ascending order, so the first of any equal ones wins,
+    // as it would when scanning.
+    auto range = static_cast<uint64_t>(max_value) -
+                 static_cast<uint64_t>(min_value_);
+    if (range < indexed_vals_ * 4) {
+      dense_index_.assign(static_cast<size_t>(range + 1), nullptr);
+      for (auto it = vals.vec.rbegin(); it != vals.vec.rend(); ++it)
+        dense_index_[static_cast<size_t>((*it)->value - min_value_)] = *it;
+    } else {
+      size_t size = 4;
+      while (size < indexed_vals_ * 2) size *= 2;  // At most half full.
+      hashed_index_.assign(size, nullptr);
+      for (auto it = vals.vec.begin(); it != vals.vec.end(); ++it) {
+        auto i = HashValue((*it)->value) & (size - 1);
+        while (hashed_index_[i] && hashed_index_[i]->value != (*it)->value)
+          i = (i + 1) & (size - 1);
+        if (!hashed_index_[i]) hashed_index_[i] = *it;
+      }
+    }
+  }
+
+  bool HasReverseIndex() const {
+    return indexed_vals_ && indexed_vals_ == vals.vec.size();
+  }
+
   Offset<reflection::Enum> Serialize(FlatBufferBuilder *builder) const;
 
   SymbolTable<EnumVal> vals;
   bool is_union;
   Type underlying_type;
+
+ private:
+  static size_t HashValue(int64_t value) {
+    return static_cast<size_t>((static_cast<uint64_t>(value) *
+                                0x9E3779B97F4A7C15ULL) >> 32);
+  }
+
+  size_t indexed_vals_;  // How many vals the index below was built for.
+  int64_t min_value_;
+  std::vector<EnumVal *> dense_index_;   // By value - min_value_.
+  std::vector<EnumVal *> hashed_index_;  // Open addressing, by HashValue().
 };
 
 class Parser {
@@ -291,9 +479,12 @@ class Parser {
     : root_struct_def_(nullptr),
       source_(nullptr),
       cursor_(nullptr),
+      end_(nullptr),
       line_(1),
       proto_mode_(proto_mode),
-      strict_json_(strict_json) {
+      strict_json_(strict_json),
+      stream_filename_(nullptr),
+      schema_(this) {
     // Just in case none are declared:
     namespaces_.push_back(new Namespace());
     known_attributes_.insert("deprecated");
@@ -307,6 +498,26 @@ class Parser {
     known_attributes_.insert("nested_flatbuffer");
   }
 
+  // Creates a parser for JSON data only, using the definitions parsed by
+  // "schema" rather than its own. Parsing data doesn't modify any
+  // definitions, so once "schema" is done parsing its schema, it can be
+  // shared by any number of these (one per thread), while also being used
+  // with GenerateText(). "schema" must outlive them.
+  explicit Parser(const Parser *schema, bool strict_json = false)
+    : root_struct_def_(schema->root_struct_def_),
+      file_identifier_(schema->file_identifier_),
+      file_extension_(schema->file_extension_),
+      source_(nullptr),
+      cursor_(nullptr),
+      end_(nullptr),
+      line_(1),
+      proto_mode_(false),
+      strict_json_(strict_json),
+      stream_filename_(nullptr),
+      schema_(schema) {
+    namespaces_.push_back(new Namespace());
+  }
+
   ~Parser() {
     for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it) {
       delete *it;
@@ -325,6 +536,32 @@ class Parser {
   bool Parse(const char *_source, const char **include_paths = nullptr,
              const char *source_filename = nullptr);
 
+  // As above, but for "length" bytes of source which need not be
+  // 0-terminated, such as a memory mapped file or a network buffer. These
+  // are parsed in place, without copying.
+  bool Parse(const char *source, size_t length,
+             const char **include_paths = nullptr,
+             const char *source_filename = nullptr);
+
+  // Start parsing JSON data containing any number of objects of the root
+  // type one after another, such as newline-delimited JSON, using the schema
+  // parsed before. Call ParseNextJson() to get each object in turn.
+  // "source" must stay valid (and be 0-terminated) until done.
+  // "line" is the line number "source" starts at, for error messages.
+  void StartJsonStream(const char *source,
+                       const char *source_filename = nullptr,
+                       int line = 1);
+  // As above, for "length" bytes of source that need not be 0-terminated.
+  void StartJsonStream(const char *source, size_t length,
+                       const char *source_filename = nullptr,
+                       int line = 1);
+
+  // Parse the next object from the data passed to StartJsonStream() into
+  // builder_, which is reused (and cleared) for every object.
+  // Returns false at the end of the data, or if there was an error, in
+  // which case error_ is set.
+  bool ParseNextJson();
+
   // Set the root type. May override the one set in the schema.
   bool SetRootType(const char *name);
 
@@ -346,7 +583,21 @@ class Parser {
   // See reflection/reflection.fbs
   void Serialize();
 
+  // Fills the symbol tables from a binary schema, such as made by Serialize(),
+  // which is much faster than parsing its text. Binary schemas have no
+  // namespaces, attributes or doc comments, so this suits parsing and
+  // generating JSON, but not generating code. "schema" should be verified
+  // first, and may be freed afterwards.
+  // Returns false if it is malformed or redefines a type, setting error_.
+  bool Deserialize(const reflection::Schema &schema);
+
  private:
+  void SetError(const std::string &msg, const char *source_filename);
+  void BuildLookupIndices();
+  // The char at cursor_ + i, or 0 at the end of the source.
+  char PeekChar(size_t i = 0) const {
+    return i < static_cast<size_t>(end_ - cursor_) ? cursor_[i] : '\0';
+  }
   int64_t ParseHexNum(int nibbles);
   void Next();
   bool IsNext(int t);
@@ -359,16 +610,19 @@ class Parser {
                      const std::string &name,
                      const Type &type);
   void ParseField(StructDef &struct_def);
-  void ParseAnyValue(Value &val, FieldDef *field);
+  ScalarValue ParseAnyValue(const Type &type, FieldDef *field);
   uoffset_t ParseTable(const StructDef &struct_def);
-  void SerializeStruct(const StructDef &struct_def, const Value &val);
+  void SerializeStruct(const StructDef &struct_def, ScalarValue val);
   void AddVector(bool sortbysize, int count);
   uoffset_t ParseVector(const Type &type);
+  uoffset_t ParseBase64Vector();
   void ParseMetaData(Definition &def);
   bool TryTypedValue(int dtoken, bool check, Value &e, BaseType req);
-  void ParseHash(Value &e, FieldDef* field);
+  int64_t ParseHash(const Type &type, FieldDef *field);
   void ParseSingleValue(Value &e);
-  int64_t ParseIntegerFromString(Type &type);
+  double ParseFloat(const Type &type);
+  ScalarValue ParseScalar(const Type &type);
+  int64_t ParseIntegerFromString(const Type &type);
   StructDef *LookupCreateStruct(const std::string &name);
   void ParseEnum(bool is_union);
   void ParseNamespace();
@@ -392,7 +646,7 @@ class Parser {
   std::map<std::string, std::set<std::string>> files_included_per_file_;
 
  private:
-  const char *source_, *cursor_;
+  const char *source_, *cursor_, *end_;
   int line_;  // the current line being parsed
   int token_;
   std::stack<std::string> files_being_parsed_;
@@ -400,13 +654,73 @@ class Parser {
   bool strict_json_;
   std::string attribute_;
   std::vector<std::string> doc_comment_;
+  const char *stream_filename_;  // As passed to StartJsonStream().
+  const Parser *schema_;  // Where definitions are looked up, usually this.
+  DefinitionArena arena_;  // Owns all definitions in the symbol tables.
 
-  std::vector<std::pair<Value, FieldDef *>> field_stack_;
+  std::vector<std::pair<ScalarValue, FieldDef *>> field_stack_;
   std::vector<uint8_t> struct_stack_;
 
   std::set<std::string> known_attributes_;
 };
 
+// Converts newline-delimited JSON, i.e. "length" bytes at "source" holding
+// objects of the root type of "schema" one per line, to binary.
+// The input is cut into chunks at line boundaries, which are parsed by
+// "num_threads" threads (0 for one per core), each with its own Parser
+// sharing "schema". "output" is called on the calling thread with the
+// resulting buffers in input order, a chunk at a time, each buffer
+// preceded by its size as a little endian uoffset_t. Each of these is laid
+// out like a buffer finished with a size prefix, and padded such that the
+// prefix and buffer together are a multiple of 16 bytes, so if the output
+// is stored 16 byte aligned, the contents of every buffer are as aligned as
+// they need to be (though the buffers themselves start 4 bytes past that).
+// Only a few chunks per thread are in flight at any time, so memory use
+// doesn't grow with the size of the input.
+// Returns false and sets "error" at the first line that fails to parse,
+// after outputting the buffers of all lines before it.
+extern bool ParseJsonLines(
+    const Parser &schema, const char *source, size_t length,
+    const char *source_filename,
+    const std::function<void(const uint8_t *, size_t)> &output,
+    std::string *error, int num_threads = 0);
+
+// Parsed schemas, shared by any number of Parser(const Parser *) instances
+// on any thread, so that each schema is only parsed once for as long as its
+// files don't change. Thread-safe.
+class SchemaCache {
+ public:
+  // Returns the schema in file "filename" (text, or binary if it ends in
+  // .bfbs), which is parsed only if not cached yet, or if it or any file
+  // it includes changed since (which is checked by hashing their contents).
+  // Earlier versions stay valid for as long as they're held on to.
+  // Returns nullptr and sets "error" if the schema fails to load or parse.
+  std::shared_ptr<const Parser> Get(const std::string &filename,
+                                    const char **include_paths,
+                                    std::string *error);
+
+  // Drops all schemas (those still held on to stay valid).
+  void Clear();
+
+  // The cache shared by the whole process.
+  static SchemaCache &Global();
+
+ private:
+  struct Entry {
+    Entry() : loading(true) {}
+    std::shared_ptr<const Parser> parser;  // nullptr if it failed to load.
+    // All files the schema was parsed from, by absolute path, with the hash
+    // of their contents.
+    std::map<std::string, uint64_t> file_hashes;
+    bool loading;  // By the Get() that added it, without holding mutex_.
+  };
+
+  std::mutex mutex_;  // Held only to look up and change entries_.
+  std::condition_variable loaded_;  // Signalled when any entry is loaded.
+  // By path and include paths.
+  std::map<std::string, std::shared_ptr<Entry>> entries_;
+};
+
 // Utility functions for multiple generators:
 
 extern std::string MakeCamel(const std::string &in, bool first = true);
@@ -429,6 +743,8 @@ struct GeneratorOptions {
   bool include_dependence_headers;
   bool mutable_buffer;
   bool one_file;
+  bool base64_byte_vectors;
+  int num_threads;  // For GenerateText(), 0 for one per core.
 
   // Possible options for the more general generator below.
   enum Language { kJava, kCSharp, kGo, kMAX };
@@ -442,6 +758,8 @@ struct GeneratorOptions {
                        include_dependence_headers(true),
                        mutable_buffer(false),
                        one_file(false),
+                       base64_byte_vectors(false),
+                       num_threads(1),
                        lang(GeneratorOptions::kJava) {}
 };
 
@@ -451,10 +769,69 @@ struct GeneratorOptions {
 // if it is less than 0, no linefeeds will be generated either.
 // See idl_gen_text.cpp.
 // strict_json adds "quotes" around field names if true.
+// If num_threads isn't 1, large vectors of tables are generated by that many
+// threads (0 for one per core), with the same result.
 extern void GenerateText(const Parser &parser,
                          const void *flatbuffer,
                          const GeneratorOptions &opts,
                          std::string *text);
+
+// Receives generated text a piece at a time. Returns false to stop.
+typedef std::function<bool(const char *text, size_t length)> TextSink;
+
+// As above, but streams the text to "sink" in pieces of a fixed size as it
+// goes, rather than holding all of it in memory.
+// Returns false if the sink did, leaving the text incomplete.
+extern bool GenerateText(const Parser &parser,
+                         const void *flatbuffer,
+                         const GeneratorOptions &opts,
+                         const TextSink &sink);
+// As above, writing to "file" (for a file descriptor, see fdopen()).
+extern bool GenerateText(const Parser &parser,
+                         const void *flatbuffer,
+                         const GeneratorOptions &opts,
+                         FILE *file);
+
+// Like GenerateText(), but only for the part of "flatbuffer" selected by
+// "path", which costs only as much as the text generated. The path names
+// fields separated by ".", each of which may be followed by "[i]" to select
+// element i of a vector, or "[begin:end]" to select a range of elements,
+// whose selections are generated as an array, e.g. "monsters[10:20].pos".
+// Negative indices count from the end, and either end of a range may be
+// left out. Absent fields are generated as their default, or null, as is a
+// union holding a member the rest of the path doesn't fit.
+// Appends to "text", or returns false and sets "error" if the path is
+// malformed or doesn't fit the schema (checked before reading any data), or
+// an index is out of range.
+extern bool GenerateTextAtPath(const Parser &parser,
+                               const void *flatbuffer,
+                               const std::string &path,
+                               const GeneratorOptions &opts,
+                               std::string *text,
+                               std::string *error);
+
+// Flattens the vector of tables or structs at "vector_path" (fields from the
+// root separated by ".", e.g. "world.monsters") into a row per element of
+// values separated by "separator", such as ',' for CSV or '\t' for TSV,
+// each line ending in '\n', and streams the text to "sink" in pieces of a
+// fixed size. The first row names the columns: "column_paths", each a
+// scalar or string reached through structs and tables by field names
+// separated by ".", e.g. "pos.x" or "enemy.name", or if empty, all scalars
+// and strings of the elements, and of the structs in them. Values are
+// formatted as in JSON (with enums as identifiers if opts asks for them),
+// but strings are quoted only if they contain the separator, a quote or a
+// line break, with any quotes doubled. Absent tables and strings are empty.
+// Returns false and sets "error" if a path doesn't fit the schema, or the
+// sink returned false.
+extern bool GenerateCsv(const Parser &parser,
+                        const void *flatbuffer,
+                        const std::string &vector_path,
+                        const std::vector<std::string> &column_paths,
+                        char separator,
+                        const GeneratorOptions &opts,
+                        const TextSink &sink,
+                        std::string *error);
+
 extern bool GenerateTextFile(const Parser &parser,
                              const std::string &path,
                              const std::string &file_name,
@@ -0,0 +1,117 @@
+// automatically generated by the FlatBuffers compiler, do not modify
+
+#ifndef FLATBUFFERS_GENERATED_PATCH_REFLECTION_H_
+#define FLATBUFFERS_GENERATED_PATCH_REFLECTION_H_
+
+#include "flatbuffers/flatbuffers.h"
+
+
+namespace reflection {
+
+struct PatchEdit;
+struct Patch;
+
+enum PatchOp {
+  SetBytes = 0,
+  SetString = 1,
+  Resize = 2,
+  Replace = 3
+};
+
+inline const char **EnumNamesPatchOp() {
+  static const char *names[] = { "SetBytes", "SetString", "Resize", "Replace", nullptr };
+  return names;
+}
+
+inline const char *EnumNamePatchOp(PatchOp e) { return EnumNamesPatchOp()[static_cast<int>(e)]; }
+
+struct PatchEdit FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  PatchOp op() const { return static_cast<PatchOp>(GetField<int8_t>(4, 0)); }
+  const flatbuffers::Vector<uint32_t> *path() const { return GetPointer<const flatbuffers::Vector<uint32_t> *>(6); }
+  const flatbuffers::Vector<uint8_t> *data() const { return GetPointer<const flatbuffers::Vector<uint8_t> *>(8); }
+  uint32_t length() const { return GetField<uint32_t>(10, 0); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int8_t>(verifier, 4 /* op */) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 6 /* path */) &&
+           verifier.Verify(path()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 8 /* data */) &&
+           verifier.Verify(data()) &&
+           VerifyField<uint32_t>(verifier, 10 /* length */) &&
+           verifier.EndTable();
+  }
+};
+
+struct PatchEditBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_op(PatchOp op) { fbb_.AddElement<int8_t>(4, static_cast<int8_t>(op), 0); }
+  void add_path(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> path) { fbb_.AddOffset(6, path); }
+  void add_data(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data) { fbb_.AddOffset(8, data); }
+  void add_length(uint32_t length) { fbb_.AddElement<uint32_t>(10, length, 0); }
+  PatchEditBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  PatchEditBuilder &operator=(const PatchEditBuilder &);
+  flatbuffers::Offset<PatchEdit> Finish() {
+    auto o = flatbuffers::Offset<PatchEdit>(fbb_.EndTable(start_, 4));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<PatchEdit> CreatePatchEdit(flatbuffers::FlatBufferBuilder &_fbb,
+   PatchOp op = SetBytes,
+   flatbuffers::Offset<flatbuffers::Vector<uint32_t>> path = 0,
+   flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data = 0,
+   uint32_t length = 0) {
+  PatchEditBuilder builder_(_fbb);
+  builder_.add_length(length);
+  builder_.add_data(data);
+  builder_.add_path(path);
+  builder_.add_op(op);
+  return builder_.Finish();
+}
+
+struct Patch FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  const flatbuffers::Vector<flatbuffers::Offset<PatchEdit>> *edits() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<PatchEdit>> *>(4); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, 4 /* edits */) &&
+           verifier.Verify(edits()) &&
+           verifier.VerifyVectorOfTables(edits()) &&
+           verifier.EndTable();
+  }
+};
+
+struct PatchBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_edits(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<PatchEdit>>> edits) { fbb_.AddOffset(4, edits); }
+  PatchBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  PatchBuilder &operator=(const PatchBuilder &);
+  flatbuffers::Offset<Patch> Finish() {
+    auto o = flatbuffers::Offset<Patch>(fbb_.EndTable(start_, 1));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<Patch> CreatePatch(flatbuffers::FlatBufferBuilder &_fbb,
+   flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<PatchEdit>>> edits = 0) {
+  PatchBuilder builder_(_fbb);
+  builder_.add_edits(edits);
+  return builder_.Finish();
+}
+
+inline const reflection::Patch *GetPatch(const void *buf) { return flatbuffers::GetRoot<reflection::Patch>(buf); }
+
+inline bool VerifyPatchBuffer(flatbuffers::Verifier &verifier) { return verifier.VerifyBuffer<reflection::Patch>(); }
+
+inline const char *PatchIdentifier() { return "BFPA"; }
+
+inline bool PatchBufferHasIdentifier(const void *buf) { return flatbuffers::BufferHasIdentifier(buf, PatchIdentifier()); }
+
+inline const char *PatchExtension() { return "bfpa"; }
+
+inline void FinishPatchBuffer(flatbuffers::FlatBufferBuilder &fbb, flatbuffers::Offset<reflection::Patch> root) { fbb.Finish(root, PatchIdentifier()); }
+
+}  // namespace reflection
+
+#endif  // FLATBUFFERS_GENERATED_PATCH_REFLECTION_H_
@@ -23,6 +23,7 @@
 // previous version of flatc whenever this code needs to change.
 // See reflection/generate_code.sh
 #include "flatbuffers/reflection_generated.h"
+#include "flatbuffers/patch_generated.h"
 
 // Helper functionality for reflection.
 
@@ -107,13 +108,13 @@ inline Table *GetFieldT(const Table &table,
 
 // Raw helper functions used below: get any value in memory as a 64bit int, a
 // double or a string.
-// All scalars get static_cast to an int64_t, strings use strtoull, every other
-// data type returns 0.
+// All scalars get static_cast to an int64_t, strings use StringToInt, every
+// other data type returns 0.
 int64_t GetAnyValueI(reflection::BaseType type, const uint8_t *data);
-// All scalars static cast to double, strings use strtod, every other data
-// type is 0.0.
+// All scalars static cast to double, strings use StringToFloat, every other
+// data type is 0.0.
 double GetAnyValueF(reflection::BaseType type, const uint8_t *data);
-// All scalars converted using stringstream, strings as-is, and all other
+// All scalars converted using NumToString, strings as-is, and all other
 // data types provide some level of debug-pretty-printing.
 std::string GetAnyValueS(reflection::BaseType type, const uint8_t *data,
                          const reflection::Schema *schema,
@@ -407,6 +408,173 @@ inline bool SetFieldT(Table *table, const reflection::Field &field,
   return table->SetPointer(field.offset(), val);
 }
 
+// Removes any data from a FlatBuffer that is no longer reachable from its
+// root, such as strings and tables that were replaced by pointing a field
+// elsewhere after AddFlatBuffer. All reachable data is moved together and the
+// offsets referring to it are adjusted; vtables are kept as they are, so this
+// is considerably cheaper than a round trip through CopyTable.
+// Returns the number of bytes reclaimed. Any pointers into "flatbuf" are
+// invalidated by this call (including pointer_inside_vector ones).
+// The FlatBuffer must not contain fields unknown to the schema.
+// If your FlatBuffer's root table is not the schema's root table, you should
+// pass in your root_table type as well.
+size_t CompactFlatBuffer(const reflection::Schema &schema,
+                         std::vector<uint8_t> *flatbuf,
+                         const reflection::Object *root_table = nullptr);
+
+// ------------------------- PATCHING -------------------------
+
+// Computes the differences between two FlatBuffers of the same schema, and
+// stores them in "fbb" as a FlatBuffer of type reflection::Patch (see
+// reflection/patch.fbs). This is typically much smaller than "newbuf" when
+// only a few values changed, e.g. to send an update over the network.
+// Changed scalars, structs and vector elements are stored as bytes to
+// overwrite, changed strings and vector sizes as new values. Anything that
+// can't be changed in-place (fields added or removed, a union changing type,
+// new vector elements) is stored as a copy of the smallest table (or string)
+// enclosing it.
+// Both buffers are walked as trees: if "oldbuf" shares an object between
+// several places, an edit to one of them affects all of them.
+// Returns the number of edits, 0 if the buffers are equal.
+// If your FlatBuffers' root table is not the schema's root table, you should
+// pass in your root_table type as well.
+size_t DiffFlatBuffers(FlatBufferBuilder &fbb,
+                       const reflection::Schema &schema,
+                       const uint8_t *oldbuf, const uint8_t *newbuf,
+                       const reflection::Object *root_table = nullptr);
+
+// Applies a patch created by DiffFlatBuffers to (a copy of) the old buffer,
+// using the setters and resizing functions above, and AddFlatBuffer for any
+// new objects. The buffer equals the new one afterwards, apart from
+// unreachable data left behind, which CompactFlatBuffer can remove.
+// Returns false if an edit doesn't fit the buffer, in which case the edits
+// before it have already been applied.
+// If your FlatBuffer's root table is not the schema's root table, you should
+// pass in your root_table type as well.
+bool ApplyFlatBufferPatch(const reflection::Schema &schema,
+                          const reflection::Patch &patch,
+                          std::vector<uint8_t> *flatbuf,
+                          const reflection::Object *root_table = nullptr);
+
+// ------------------------- COLUMNS -------------------------
+
+// The values of one scalar field of every table in a vector, stored
+// contiguously in vector order, such that they can be scanned (or
+// vectorized) without following an offset and a vtable for each of them.
+// Tables that don't store the field contribute its default value.
+struct Column {
+  const reflection::Field *field;
+  uoffset_t size;
+  std::vector<uint8_t> data;     // "size" values of the field's type.
+  std::vector<uint8_t> present;  // Bit i (LSB first) set if table i stores it.
+
+  template<typename T> const T *Data() const {
+    assert(sizeof(T) == GetTypeSize(field->type()->base_type()));
+    return reinterpret_cast<const T *>(data.data());
+  }
+
+  bool IsPresent(uoffset_t i) const {
+    return (present[i / 8] >> (i % 8)) & 1;
+  }
+};
+
+// Collects the fields named in "field_names" (which must all be scalar fields
+// of "objectdef") from every table in "tables" into "columns", one column per
+// name. Returns false if any of the names doesn't refer to a scalar field.
+bool ExportColumns(const reflection::Object &objectdef,
+                   const Vector<Offset<Table>> &tables,
+                   const std::vector<std::string> &field_names,
+                   std::vector<Column> *columns);
+
+// Stores "columns" in "fbb" as a table with a vector of the values of column
+// i as field i, followed by the presence bitmaps as fields n + i, i.e. the
+// layout of a schema like:
+// table Columns { hp:[short]; mana:[short]; hp_present:[ubyte];
+//                 mana_present:[ubyte]; }
+Offset<const Table *> CreateColumnTable(FlatBufferBuilder &fbb,
+                                        const std::vector<Column> &columns);
+
+// The same for generated code, given an accessor such as &Monster::hp.
+// Generated accessors can't tell whether a field is stored, so this only
+// collects values.
+template<typename T, typename U> void ExportColumn(
+    const Vector<Offset<T>> &tables, U (T::*accessor)() const,
+    std::vector<U> *column) {
+  column->resize(tables.size());
+  for (uoffset_t i = 0; i < tables.size(); i++) {
+    (*column)[i] = (tables.Get(i)->*accessor)();
+  }
+}
+
+// ------------------------- FILTERING -------------------------
+
+// A condition on the scalar fields of a table, such as
+// "hp > 50 && color == Blue", compiled once into a flat program that can then
+// be evaluated against any number of tables (or buffers) of that type.
+// Supports comparisons (== != < <= > >=) of a field against a number, true,
+// false or (for fields of an enum type) the name of an enum value, a field by
+// itself (true if not 0), and combining these with ! && || and parentheses.
+// && and || only evaluate their right hand side if needed.
+// Fields not stored in a table compare as their default value.
+// Evaluation remembers the field locations for the last vtable seen, which
+// most tables (even in different buffers) share, so a Predicate must not be
+// used from multiple threads at once (copy it instead).
+class Predicate {
+ public:
+  Predicate(const reflection::Schema &schema,
+            const reflection::Object &objectdef);
+
+  // Returns false if the expression can't be parsed, see error().
+  bool Compile(const std::string &expression);
+  const std::string &error() const { return error_; }
+
+  // Matches nothing after Compile() failed, until it succeeds.
+  bool Match(const Table &table);
+
+  // Evaluates "count" buffers (with the table this predicate was created for
+  // as root), and appends the index of each buffer that matches to
+  // "selected". Returns the number of buffers matched.
+  size_t Filter(const uint8_t *const *buffers, size_t count,
+                std::vector<size_t> *selected);
+
+ private:
+  enum Op { kCompare, kNot, kJumpIfFalse, kJumpIfTrue };
+  enum Comparison { kEq, kNe, kLt, kLe, kGt, kGe };
+
+  struct Instruction {
+    Op op;
+    Comparison comparison;
+    size_t field;    // Index into fields_, for kCompare.
+    bool is_float;   // Compare as doubles rather than integers.
+    int64_t i;       // The value to compare with.
+    double f;
+    size_t target;   // Instruction to jump to.
+  };
+
+  bool ParseOr();
+  bool ParseAnd();
+  bool ParseUnary();
+  bool ParseComparison();
+  bool ParseValue(const reflection::Field &fielddef, Instruction *ins);
+  std::string NextIdentifier();
+  void SkipWhitespace();
+  bool Expect(const char *token);
+  bool Fail(const std::string &msg);
+  void LookupFields(const Table &table);
+
+  const reflection::Schema &schema_;
+  const reflection::Object &objectdef_;
+  std::vector<const reflection::Field *> fields_;
+  std::vector<Instruction> program_;
+  std::string error_;
+  const char *cursor_;
+  // A copy of the last vtable seen (compared by contents, since buffers
+  // may be freed and reallocated at the same address), and where each of
+  // fields_ is stored according to it.
+  std::vector<uint8_t> vtable_;
+  std::vector<voffset_t> field_offsets_;
+};
+
 // ------------------------- COPYING -------------------------
 
 // Generic copying of tables from a FlatBuffer into a FlatBuffer builder.
@@ -414,13 +582,72 @@ inline bool SetFieldT(Table *table, const reflection::Field &field,
 // of existing buffers. Also useful to reconstruct a whole buffer if the
 // above resizing functionality has introduced garbage in a buffer you want
 // to remove.
-// Note: this does not deal with DAGs correctly. If the table passed forms a
+// Note: by default this does not deal with DAGs. If the table passed forms a
 // DAG, the copy will be a tree instead (with duplicates).
+// Pass "preserve_dags" to remember every table, string and vector copied by
+// its address in the source buffer, such that anything referred to more than
+// once is also only stored once in the copy (at the cost of a map lookup per
+// object copied).
 
 Offset<const Table *> CopyTable(FlatBufferBuilder &fbb,
                                 const reflection::Schema &schema,
                                 const reflection::Object &objectdef,
-                                const Table &table);
+                                const Table &table,
+                                bool preserve_dags = false);
+
+// A set of fields to keep when copying a table with ProjectTable below.
+// Fields are selected with paths relative to the table the mask was created
+// for, separated by '.', e.g. "hp" or "enemy.name". Fields of type table or
+// vector of tables may be followed into, such that "testarrayoftables.hp"
+// keeps just the hp of each element. A field named without any further
+// path is kept as a whole, including everything it refers to.
+// Required fields are always kept, such that the result still verifies.
+// Create a mask once and reuse it for any number of copies: it resolves all
+// field names up front.
+class FieldMask {
+ public:
+  FieldMask(const reflection::Schema &schema,
+            const reflection::Object &objectdef);
+  ~FieldMask();
+
+  // Add a path to the selection. Returns false if it doesn't name a field,
+  // or continues past a field that is not a table (or vector of tables).
+  // Unions can only be selected as a whole.
+  bool Add(const std::string &path);
+
+  // The compiled form of the selection, one node per table selected into.
+  struct Node {
+    struct Field {
+      const reflection::Field *field;
+      Node *sub;  // Fields to keep in the subtable(s), or nullptr for all.
+    };
+    std::vector<Field> fields;  // In order of field id.
+    voffset_t vtable_size;      // Highest field id selected + 1.
+  };
+
+  const reflection::Schema &schema() const { return schema_; }
+  const reflection::Object &object() const { return objectdef_; }
+  const Node *root() const { return root_; }
+
+ private:
+  FieldMask(const FieldMask &);
+  FieldMask &operator=(const FieldMask &);
+
+  Node *NewNode(const reflection::Object &objectdef);
+  Node::Field &Select(Node *node, const reflection::Field &fielddef);
+
+  const reflection::Schema &schema_;
+  const reflection::Object &objectdef_;
+  std::vector<Node *> nodes_;
+  Node *root_;
+};
+
+// Like CopyTable, but only copies the fields selected by "mask" (and anything
+// they refer to). "table" must be of the type the mask was created for.
+Offset<const Table *> ProjectTable(FlatBufferBuilder &fbb,
+                                   const FieldMask &mask,
+                                   const Table &table,
+                                   bool preserve_dags = false);
 
 }  // namespace flatbuffers
 
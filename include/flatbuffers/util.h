@@ -17,10 +17,18 @@
 #ifndef FLATBUFFERS_UTIL_H_
 #define FLATBUFFERS_UTIL_H_
 
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <limits>
+#include <type_traits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <clocale>
 #include <stdlib.h>
 #include <assert.h>
 #ifdef _WIN32
@@ -40,41 +48,351 @@
 
 namespace flatbuffers {
 
+// Number conversion kernels. These write to / read from plain char buffers
+// without allocating, and don't depend on the current locale.
+
+// Enough room for any number NumToChars() writes.
+static const size_t kNumToCharsBufferSize = 352;
+
+// Writes the decimal digits of "val" to "buf", returns the end.
+inline char *UIntToChars(uint64_t val, char *buf) {
+  static const char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343"
+    "53637383940414243444546474849505152535455565758596061626364656667686970"
+    "7172737475767778798081828384858687888990919293949596979899";
+  char tmp[20];
+  auto p = tmp + sizeof(tmp);
+  while (val >= 100) {
+    auto pair = kDigitPairs + (val % 100) * 2;
+    val /= 100;
+    *--p = pair[1];
+    *--p = pair[0];
+  }
+  if (val >= 10) {
+    auto pair = kDigitPairs + val * 2;
+    *--p = pair[1];
+    *--p = pair[0];
+  } else {
+    *--p = static_cast<char>('0' + val);
+  }
+  auto len = tmp + sizeof(tmp) - p;
+  memcpy(buf, p, len);
+  return buf + len;
+}
+
+inline char *IntToChars(int64_t val, char *buf) {
+  if (val >= 0) return UIntToChars(static_cast<uint64_t>(val), buf);
+  *buf++ = '-';
+  return UIntToChars(0 - static_cast<uint64_t>(val), buf);
+}
+
+// Shortest round-trip float formatting, using Grisu2 (Florian Loitsch,
+// "Printing Floating-Point Numbers Quickly and Accurately with Integers").
+// It always produces digits that parse back to the same value, and the
+// shortest such digits in all but a very small number of cases.
+namespace grisu {
+
+struct DiyFp {
+  DiyFp(uint64_t _f, int _e) : f(_f), e(_e) {}
+  uint64_t f;
+  int e;
+};
+
+inline DiyFp Sub(const DiyFp &x, const DiyFp &y) {
+  return DiyFp(x.f - y.f, x.e);
+}
+
+// The upper 64 bits of the 128 bit product, rounded.
+inline DiyFp Mul(const DiyFp &x, const DiyFp &y) {
+  const uint64_t kM32 = 0xFFFFFFFFu;
+  auto a = x.f >> 32, b = x.f & kM32, c = y.f >> 32, d = y.f & kM32;
+  auto ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  auto tmp = (bd >> 32) + (ad & kM32) + (bc & kM32) + (1u << 31);
+  return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+inline DiyFp Normalize(DiyFp x) {
+  while (!(x.f >> 63)) { x.f <<= 1; x.e--; }
+  return x;
+}
+
+// The value and the boundaries halfway to its neighbours, all with the
+// same exponent for the boundaries. Computed in the precision of T, so
+// floats get digits for float, not for the double they convert to.
+struct Boundaries {
+  Boundaries(DiyFp _w, DiyFp _minus, DiyFp _plus)
+    : w(_w), minus(_minus), plus(_plus) {}
+  DiyFp w, minus, plus;
+};
+
+template<typename T> Boundaries ComputeBoundaries(T value) {
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double only");
+  const int kPrecision = std::numeric_limits<T>::digits;  // Hidden bit too.
+  const int kBias = std::numeric_limits<T>::max_exponent - 1 +
+                    (kPrecision - 1);
+  const uint64_t kHiddenBit = 1ULL << (kPrecision - 1);
+  uint64_t bits;
+  if (sizeof(T) == 4) {
+    uint32_t bits32;
+    memcpy(&bits32, &value, sizeof(bits32));
+    bits = bits32;
+  } else {
+    memcpy(&bits, &value, sizeof(bits));
+  }
+  auto exp_bits = static_cast<int>(bits >> (kPrecision - 1));
+  auto fraction = bits & (kHiddenBit - 1);
+  DiyFp v = exp_bits ? DiyFp(fraction + kHiddenBit, exp_bits - kBias)
+                     : DiyFp(fraction, 1 - kBias);  // Denormal.
+  auto lower_closer = !fraction && exp_bits > 1;
+  auto plus = Normalize(DiyFp(2 * v.f + 1, v.e - 1));
+  auto minus = lower_closer ? DiyFp(4 * v.f - 1, v.e - 2)
+                            : DiyFp(2 * v.f - 1, v.e - 1);
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+  return Boundaries(Normalize(v), minus, plus);
+}
+
+struct CachedPower {  // c = f * 2^e ~= 10^k
+  uint64_t f;
+  int e;
+  int k;
+};
+
+// Returns a power of ten c such that the exponent of (c * 2^e) lands in
+// [-60, -32], so that the integral part of the product fits in 32 bits.
+inline CachedPower GetCachedPower(int e) {
+  static const CachedPower kCachedPowers[] = {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+  };
+  const int kAlpha = -60;
+  const int kMinDecExp = -300;
+  const int kDecStep = 8;
+  auto f = kAlpha - e - 1;
+  auto k = (f * 78913) / (1 << 18) + (f > 0);  // ceil(f * log10(2))
+  auto index = (-kMinDecExp + k + (kDecStep - 1)) / kDecStep;
+  assert(index >= 0 && index < static_cast<int>(sizeof(kCachedPowers) /
+                                                sizeof(kCachedPowers[0])));
+  return kCachedPowers[index];
+}
+
+// Returns the number of decimal digits of n < 10^10, and sets "pow10" to
+// 10 ^ (that - 1).
+inline int FindLargestPow10(uint32_t n, uint32_t *pow10) {
+  int digits = 10;
+  *pow10 = 1000000000;
+  while (digits > 1 && n < *pow10) {
+    *pow10 /= 10;
+    digits--;
+  }
+  return digits;
+}
+
+// Moves the last digit down while that gets closer to the value.
+inline void Round(char *buf, int len, uint64_t dist, uint64_t delta,
+                  uint64_t rest, uint64_t ten_k) {
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    buf[len - 1]--;
+    rest += ten_k;
+  }
+}
+
+// Writes the digits of "w" to "buf", with as few as possible such that
+// the value stays within (minus, plus). Value is digits * 10^*exponent.
+inline int DigitGen(char *buf, int *exponent, DiyFp minus, DiyFp w,
+                    DiyFp plus) {
+  auto delta = Sub(plus, minus).f;
+  auto dist = Sub(plus, w).f;
+  DiyFp one(1ULL << -plus.e, plus.e);
+  auto p1 = static_cast<uint32_t>(plus.f >> -one.e);  // Integral part.
+  auto p2 = plus.f & (one.f - 1);                      // Fraction.
+  int len = 0;
+  uint32_t pow10;
+  for (int n = FindLargestPow10(p1, &pow10); n > 0; ) {
+    auto d = p1 / pow10;
+    p1 %= pow10;
+    buf[len++] = static_cast<char>('0' + d);
+    n--;
+    auto rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      *exponent += n;
+      Round(buf, len, dist, delta, rest,
+            static_cast<uint64_t>(pow10) << -one.e);
+      return len;
+    }
+    pow10 /= 10;
+  }
+  for (int m = 1; ; m++) {
+    p2 *= 10;
+    buf[len++] = static_cast<char>('0' + (p2 >> -one.e));
+    p2 &= one.f - 1;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta) {
+      *exponent -= m;
+      Round(buf, len, dist, delta, p2, one.f);
+      return len;
+    }
+  }
+}
+
+// "value" must be finite and > 0. Writes up to 17 digits.
+template<typename T> int Grisu2(T value, char *buf, int *exponent) {
+  auto b = ComputeBoundaries(value);
+  auto cached = GetCachedPower(b.plus.e);
+  DiyFp c(cached.f, cached.e);
+  auto w = Mul(b.w, c);
+  auto minus = Mul(b.minus, c);
+  auto plus = Mul(b.plus, c);
+  // Shrink the interval by an ulp on each side for the rounding in Mul.
+  minus.f++;
+  plus.f--;
+  *exponent = -cached.k;
+  return DigitGen(buf, exponent, minus, w, plus);
+}
+
+}  // namespace grisu
+
+// Writes the shortest decimal that parses back to "val", without using
+// scientific notation (which our JSON parser wouldn't accept).
+template<typename T> char *FloatToChars(T val, char *buf) {
+  if (val != val) { memcpy(buf, "nan", 3); return buf + 3; }
+  if (std::signbit(val)) { *buf++ = '-'; val = -val; }
+  if (val > std::numeric_limits<T>::max()) {
+    memcpy(buf, "inf", 3);
+    return buf + 3;
+  }
+  if (val == 0) { *buf++ = '0'; return buf; }
+  char digits[20];
+  int exponent;
+  auto len = grisu::Grisu2(val, digits, &exponent);
+  auto point = len + exponent;  // Digits before the decimal point.
+  if (exponent >= 0) {
+    memcpy(buf, digits, len);
+    memset(buf + len, '0', exponent);
+    return buf + point;
+  }
+  if (point > 0) {
+    memcpy(buf, digits, point);
+    buf[point] = '.';
+    memcpy(buf + point + 1, digits + point, len - point);
+    return buf + len + 1;
+  }
+  buf[0] = '0';
+  buf[1] = '.';
+  memset(buf + 2, '0', -point);
+  memcpy(buf + 2 - point, digits, len);
+  return buf + 2 - point + len;
+}
+
+// Writes any integer or floating point value as decimal to "buf", which
+// must hold at least kNumToCharsBufferSize chars. Returns the end.
+template<typename T> char *NumToChars(T t, char *buf) {
+  return std::numeric_limits<T>::is_signed
+    ? IntToChars(static_cast<int64_t>(t), buf)
+    : UIntToChars(static_cast<uint64_t>(t), buf);
+}
+template<> inline char *NumToChars<double>(double t, char *buf) {
+  return FloatToChars(t, buf);
+}
+template<> inline char *NumToChars<float>(float t, char *buf) {
+  return FloatToChars(t, buf);
+}
+
 // Convert an integer or floating point value to a string.
 // In contrast to std::stringstream, "char" values are
 // converted to a string of digits, and we don't use scientific notation.
-template<typename T> std::string NumToString(T t) {
+// Floating point values get the fewest digits that read back exactly.
+template<typename T> std::string NumToString(T t, std::true_type) {
+  char buf[kNumToCharsBufferSize];
+  return std::string(buf, NumToChars(t, buf));
+}
+// Anything else that can be streamed, e.g. enums and pointers.
+template<typename T> std::string NumToString(T t, std::false_type) {
   std::stringstream ss;
   ss << t;
   return ss.str();
 }
-// Avoid char types used as character data.
-template<> inline std::string NumToString<signed char>(signed char t) {
-  return NumToString(static_cast<int>(t));
-}
-template<> inline std::string NumToString<unsigned char>(unsigned char t) {
-  return NumToString(static_cast<int>(t));
-}
-
-// Special versions for floats/doubles.
-template<> inline std::string NumToString<double>(double t) {
-  // to_string() prints different numbers of digits for floats depending on
-  // platform and isn't available on Android, so we use stringstream
-  std::stringstream ss;
-  // Use std::fixed to surpress scientific notation.
-  ss << std::fixed << t;
-  auto s = ss.str();
-  // Sadly, std::fixed turns "1" into "1.00000", so here we undo that.
-  auto p = s.find_last_not_of('0');
-  if (p != std::string::npos) {
-    s.resize(p + 1);  // Strip trailing zeroes.
-    if (s.back() == '.')
-      s.erase(s.size() - 1, 1);  // Strip '.' if a whole number.
-  }
-  return s;
-}
-template<> inline std::string NumToString<float>(float t) {
-  return NumToString(static_cast<double>(t));
+template<typename T> std::string NumToString(T t) {
+  return NumToString(t, std::is_arithmetic<T>());
 }
 
 // Convert an integer value to a hexadecimal string.
@@ -90,13 +408,117 @@ inline std::string IntToStringHex(int i, int xdigits) {
   return ss.str();
 }
 
-// Portable implementation of strtoull().
-inline int64_t StringToInt(const char *str, int base = 10) {
-  #ifdef _MSC_VER
-    return _strtoui64(str, nullptr, base);
-  #else
-    return strtoull(str, nullptr, base);
-  #endif
+// Parses an integer like strtoull(), i.e. with an optional sign (negative
+// values wrap around), and an optional "0x" prefix in base 16.
+// Values out of range saturate. "end" is set past the last char used.
+inline int64_t StringToInt(const char *str, int base = 10,
+                           const char **end = nullptr) {
+  auto p = str;
+  while (*p == ' ' || (*p >= '\t' && *p <= '\r')) p++;
+  bool negative = *p == '-';
+  if (*p == '-' || *p == '+') p++;
+  if (base == 16 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') &&
+      isxdigit(static_cast<unsigned char>(p[2])))
+    p += 2;
+  const uint64_t kMax = std::numeric_limits<uint64_t>::max();
+  uint64_t val = 0;
+  bool overflow = false;
+  auto digits = p;
+  for (;; p++) {
+    unsigned d;
+    if (*p >= '0' && *p <= '9') d = *p - '0';
+    else if (*p >= 'a' && *p <= 'z') d = *p - 'a' + 10;
+    else if (*p >= 'A' && *p <= 'Z') d = *p - 'A' + 10;
+    else break;
+    if (d >= static_cast<unsigned>(base)) break;
+    if (val > (kMax - d) / base) overflow = true;
+    val = val * base + d;
+  }
+  if (end) *end = p == digits ? str : p;
+  if (overflow) return static_cast<int64_t>(kMax);
+  return static_cast<int64_t>(negative ? 0 - val : val);
+}
+
+// Parses a floating point number like strtod(), but always with '.' as
+// decimal point. Numbers with up to 19 significant digits and a small
+// exponent (most that appear in JSON) are converted exactly with a single
+// multiply or divide, others go through strtod() (or strtof() for T =
+// float, which avoids rounding twice).
+template<typename T> T StringToFloat(const char *str,
+                                     const char **end = nullptr) {
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  auto p = str;
+  while (*p == ' ' || (*p >= '\t' && *p <= '\r')) p++;
+  bool negative = *p == '-';
+  if (*p == '-' || *p == '+') p++;
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any_digits = false, exact = true;
+  for (; *p >= '0' && *p <= '9'; p++) {
+    any_digits = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa) digits++;
+    } else {
+      exact = false;
+    }
+  }
+  if (*p == '.') {
+    for (p++; *p >= '0' && *p <= '9'; p++) {
+      any_digits = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) digits++;
+        exponent--;
+      } else {
+        exact = false;
+      }
+    }
+  }
+  if (any_digits && (*p == 'e' || *p == 'E')) {
+    auto q = p + 1;
+    bool exp_negative = *q == '-';
+    if (*q == '-' || *q == '+') q++;
+    if (*q >= '0' && *q <= '9') {
+      int exp = 0;
+      for (; *q >= '0' && *q <= '9'; q++) {
+        if (exp < 100000) exp = exp * 10 + (*q - '0');
+      }
+      exponent += exp_negative ? -exp : exp;
+      p = q;
+    }
+  }
+  // Exact if all digits were used, the mantissa is representable in T, and
+  // so is the power of 10.
+  const int kMaxExactPow10 = sizeof(T) == 4 ? 10 : 22;
+  const uint64_t kMaxExactInt = 1ULL << std::numeric_limits<T>::digits;
+  if (any_digits && exact && mantissa <= kMaxExactInt &&
+      exponent >= -kMaxExactPow10 && exponent <= kMaxExactPow10) {
+    if (end) *end = p;
+    auto val = static_cast<T>(mantissa);
+    auto scale = static_cast<T>(kPow10[exponent < 0 ? -exponent : exponent]);
+    val = exponent < 0 ? val / scale : val * scale;
+    return negative ? -val : val;
+  }
+  // Slow path: strtod() expects the decimal point of the current locale.
+  char *strtod_end;
+  T val;
+  auto decimal_point = *localeconv()->decimal_point;
+  if (decimal_point == '.' || std::find(str, p, '.') == p) {
+    val = sizeof(T) == 4 ? static_cast<T>(strtof(str, &strtod_end))
+                         : static_cast<T>(strtod(str, &strtod_end));
+    if (end) *end = strtod_end;
+  } else {
+    std::string copy(str, p);
+    copy[copy.find('.')] = decimal_point;
+    val = sizeof(T) == 4 ? static_cast<T>(strtof(copy.c_str(), &strtod_end))
+                         : static_cast<T>(strtod(copy.c_str(), &strtod_end));
+    if (end) *end = str + (strtod_end - copy.c_str());
+  }
+  return val;
 }
 
 // Check if file "name" exists.
@@ -269,6 +691,91 @@ inline int FromUTF8(const char **in) {
   return ucc;
 }
 
+// Base64 (RFC 4648, padded with '=') conversion functions, for byte vectors
+// in JSON.
+
+// The number of characters "len" bytes encode to, including padding.
+inline size_t Base64EncodedSize(size_t len) { return (len + 2) / 3 * 4; }
+
+// Encodes "len" bytes from "src" as Base64EncodedSize(len) characters at
+// "dst".
+inline void Base64Encode(const uint8_t *src, size_t len, char *dst) {
+  static const char kChars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (; len >= 3; len -= 3, src += 3, dst += 4) {
+    uint32_t v = static_cast<uint32_t>(src[0]) << 16 |
+                 static_cast<uint32_t>(src[1]) << 8 | src[2];
+    dst[0] = kChars[v >> 18];
+    dst[1] = kChars[(v >> 12) & 63];
+    dst[2] = kChars[(v >> 6) & 63];
+    dst[3] = kChars[v & 63];
+  }
+  if (len) {
+    uint32_t v = static_cast<uint32_t>(src[0]) << 16 |
+                 (len > 1 ? static_cast<uint32_t>(src[1]) << 8 : 0);
+    dst[0] = kChars[v >> 18];
+    dst[1] = kChars[(v >> 12) & 63];
+    dst[2] = len > 1 ? kChars[(v >> 6) & 63] : '=';
+    dst[3] = '=';
+  }
+}
+
+// Given "*len" characters of base64 at "src", with or without padding, sets
+// "*len" to the number of them that aren't padding, and "*size" to the
+// number of bytes they decode to. Returns false if no base64 is that long.
+inline bool Base64DecodedSize(const char *src, size_t *len, size_t *size) {
+  auto n = *len;
+  if (n && n % 4 == 0 && src[n - 1] == '=') n -= src[n - 2] == '=' ? 2 : 1;
+  if (n % 4 == 1) return false;
+  *len = n;
+  *size = n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0);
+  return true;
+}
+
+// Decodes "len" characters of base64 from "src" (without padding, see
+// Base64DecodedSize()) to bytes at "dst".
+// Returns false upon any character that isn't base64.
+inline bool Base64Decode(const char *src, size_t len, uint8_t *dst) {
+  const uint8_t B = 0xFF;  // Not base64.
+  static const uint8_t kValues[256] = {
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, 62, B, B, B, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, B, B, B, B, B, B,
+    B, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, B, B, B, B, B,
+    B, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B,
+  };
+  // Any invalid character sets the top bit of "bad".
+  uint32_t bad = 0;
+  auto value = [&](size_t i) -> uint32_t {
+    auto v = kValues[static_cast<uint8_t>(src[i])];
+    bad |= v;
+    return v;
+  };
+  for (; len >= 4; len -= 4, src += 4, dst += 3) {
+    auto v = value(0) << 18 | value(1) << 12 | value(2) << 6 | value(3);
+    dst[0] = static_cast<uint8_t>(v >> 16);
+    dst[1] = static_cast<uint8_t>(v >> 8);
+    dst[2] = static_cast<uint8_t>(v);
+  }
+  if (len >= 2) {
+    auto v = value(0) << 18 | value(1) << 12 | (len > 2 ? value(2) << 6 : 0);
+    dst[0] = static_cast<uint8_t>(v >> 16);
+    if (len > 2) dst[1] = static_cast<uint8_t>(v >> 8);
+  }
+  return !(bad & 0x80);
+}
+
 // Wraps a string to a maximum length, inserting new lines where necessary. Any
 // existing whitespace will be collapsed down to a single space. A prefix or
 // suffix can be provided, which will be inserted before or after a wrapped
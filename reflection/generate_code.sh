@@ -1 +1,2 @@
 ../flatc -c --no-prefix -o ../include/flatbuffers reflection.fbs
+../flatc -c --no-prefix -o ../include/flatbuffers patch.fbs
@@ -72,6 +72,24 @@ const Generator generators[] = {
 
 const char *program_name = NULL;
 
+// Like GenerateTextFile(), but only for the part of the data selected by
+// "text_path".
+static void GenerateTextFileAtPath(const flatbuffers::Parser &parser,
+                                   const std::string &path,
+                                   const std::string &file_name,
+                                   const flatbuffers::GeneratorOptions &opts,
+                                   const std::string &text_path) {
+  if (!parser.builder_.GetSize() || !parser.root_struct_def_) return;
+  std::string text, err;
+  if (!flatbuffers::GenerateTextAtPath(parser,
+                                       parser.builder_.GetBufferPointer(),
+                                       text_path, opts, &text, &err))
+    Error(file_name + ": " + err, false, false);
+  if (!flatbuffers::SaveFile((path + file_name + ".json").c_str(), text,
+                             false))
+    Error("Unable to generate text for " + file_name);
+}
+
 static void Error(const std::string &err, bool usage, bool show_exe_name) {
   if (show_exe_name) printf("%s: ", program_name);
   printf("%s\n", err.c_str());
@@ -89,6 +107,17 @@ static void Error(const std::string &err, bool usage, bool show_exe_name) {
       "                  no trailing commas in tables/vectors.\n"
       "  --defaults-json Output fields whose value is the default when\n"
       "                  writing JSON\n"
+      "  --base64        Output [ubyte] and [byte] vectors as base64 strings\n"
+      "                  when writing JSON.\n"
+      "  --path PATH     With -t, only write the part of the data selected\n"
+      "                  by PATH, e.g. monsters[10:20].pos (see docs).\n"
+      "  --csv VECTOR    Write the vector of tables or structs at VECTOR in\n"
+      "                  the data (e.g. world.monsters) as CSV, a row per\n"
+      "                  element, to a .csv file.\n"
+      "  --tsv VECTOR    As --csv, but tab separated, to a .tsv file.\n"
+      "  --columns LIST  Comma separated paths of the columns for --csv and\n"
+      "                  --tsv, e.g. name,pos.x,enemy.hp (default: all\n"
+      "                  scalars and strings, and those of structs).\n"
       "  --no-prefix     Don\'t prefix enum values with the enum type in C++.\n"
       "  --scoped-enums  Use C++11 style scoped and strongly typed enums.\n"
       "                  also implies --no-prefix.\n"
@@ -103,7 +132,15 @@ static void Error(const std::string &err, bool usage, bool show_exe_name) {
       "                  This may crash flatc given a mismatched schema.\n"
       "  --proto         Input is a .proto, translate to .fbs.\n"
       "  --schema        Serialize schemas instead of JSON (use with -b)\n"
+      "  --json-lines    Convert FILEs after the one setting root_type from\n"
+      "                  newline-delimited JSON to a stream of size prefixed\n"
+      "                  binaries, in parallel.\n"
+      "  --threads N     Threads to use with --json-lines (default: 1 per\n"
+      "                  core), and to write large vectors of tables with\n"
+      "                  -t (default: 1).\n"
       "FILEs may depend on declarations in earlier files.\n"
+      "FILEs ending in .bfbs are binary schemas (see --schema), which\n"
+      "load faster than text, but can't have code generated from them.\n"
       "FILEs after the -- must be binary flatbuffer format files.\n"
       "Output files are named using the base file name of the input,\n"
       "and written to the current directory or the path given by -o.\n"
@@ -124,6 +161,12 @@ int main(int argc, const char *argv[]) {
   bool proto_mode = false;
   bool raw_binary = false;
   bool schema_binary = false;
+  bool json_lines = false;
+  int num_threads = 0;
+  std::string text_path;
+  std::string csv_vector;
+  char csv_separator = ',';
+  std::vector<std::string> csv_columns;
   std::vector<std::string> filenames;
   std::vector<const char *> include_directories;
   size_t binary_files_from = std::numeric_limits<size_t>::max();
@@ -142,6 +185,8 @@ int main(int argc, const char *argv[]) {
         opts.strict_json = true;
       } else if(arg == "--defaults-json") {
         opts.output_default_scalars_in_json = true;
+      } else if(arg == "--base64") {
+        opts.base64_byte_vectors = true;
       } else if(arg == "--no-prefix") {
         opts.prefixed_enums = false;
       } else if(arg == "--scoped-enums") {
@@ -165,6 +210,29 @@ int main(int argc, const char *argv[]) {
         any_generator = true;
       } else if(arg == "--schema") {
         schema_binary = true;
+      } else if(arg == "--json-lines") {
+        json_lines = true;
+        any_generator = true;
+      } else if(arg == "--threads") {
+        if (++argi >= argc) Error("missing count following: " + arg, true);
+        num_threads = atoi(argv[argi]);
+        opts.num_threads = num_threads;
+      } else if(arg == "--path") {
+        if (++argi >= argc) Error("missing path following: " + arg, true);
+        text_path = argv[argi];
+      } else if(arg == "--csv" || arg == "--tsv") {
+        if (++argi >= argc) Error("missing path following: " + arg, true);
+        csv_vector = argv[argi];
+        csv_separator = arg == "--csv" ? ',' : '\t';
+        any_generator = true;
+      } else if(arg == "--columns") {
+        if (++argi >= argc) Error("missing list following: " + arg, true);
+        std::string list = argv[argi];
+        for (size_t start = 0; start <= list.length(); ) {
+          auto end = std::min(list.find(',', start), list.length());
+          csv_columns.push_back(list.substr(start, end - start));
+          start = end + 1;
+        }
       } else if(arg == "-M") {
         print_make_rules = true;
       } else {
@@ -199,6 +267,41 @@ int main(int argc, const char *argv[]) {
 
       bool is_binary = static_cast<size_t>(file_it - filenames.begin()) >=
                        binary_files_from;
+      std::string filebase = flatbuffers::StripPath(
+                               flatbuffers::StripExtension(*file_it));
+      if (json_lines && !is_binary && parser.root_struct_def_) {
+        auto ext = parser.file_extension_.length() ? parser.file_extension_
+                                                   : "bin";
+        auto out_name = output_path + filebase + "." + ext;
+        if (print_make_rules) {
+          printf("%s: %s\n", out_name.c_str(), file_it->c_str());
+          continue;
+        }
+        flatbuffers::EnsureDirExists(output_path);
+        std::ofstream ofs(out_name.c_str(), std::ofstream::binary);
+        if (!ofs.is_open()) Error("unable to write file " + out_name);
+        std::string err;
+        if (!flatbuffers::ParseJsonLines(parser, contents.c_str(),
+                                         contents.length(), file_it->c_str(),
+            [&](const uint8_t *data, size_t size) {
+              ofs.write(reinterpret_cast<const char *>(data), size);
+            }, &err, num_threads))
+          Error(err, false, false);
+        if (ofs.bad()) Error("unable to write file " + out_name);
+        continue;
+      }
+      if (!is_binary && flatbuffers::StripExtension(*file_it) + "." +
+                        reflection::SchemaExtension() == *file_it) {
+        // A binary schema, load it instead of parsing the text version.
+        flatbuffers::Verifier verifier(
+          reinterpret_cast<const uint8_t *>(contents.c_str()),
+          contents.length());
+        if (!reflection::VerifySchemaBuffer(verifier))
+          Error("not a valid binary schema: " + *file_it);
+        if (!parser.Deserialize(*reflection::GetSchema(contents.c_str())))
+          Error(*file_it + ": " + parser.error_, false, false);
+        continue;
+      }
       if (is_binary) {
         parser.builder_.Clear();
         parser.builder_.PushBytes(
@@ -239,15 +342,17 @@ int main(int argc, const char *argv[]) {
         include_directories.pop_back();
       }
 
-      std::string filebase = flatbuffers::StripPath(
-                               flatbuffers::StripExtension(*file_it));
-
       for (size_t i = 0; i < num_generators; ++i) {
         opts.lang = generators[i].lang;
         if (generator_enabled[i]) {
           if (!print_make_rules) {
             flatbuffers::EnsureDirExists(output_path);
-            if (!generators[i].generate(parser, output_path, filebase, opts)) {
+            if (text_path.length() &&
+                generators[i].generate == flatbuffers::GenerateTextFile) {
+              GenerateTextFileAtPath(parser, output_path, filebase, opts,
+                                     text_path);
+            } else if (!generators[i].generate(parser, output_path, filebase,
+                                               opts)) {
               Error(std::string("Unable to generate ") +
                     generators[i].lang_name +
                     " for " +
@@ -263,6 +368,29 @@ int main(int argc, const char *argv[]) {
         }
       }
 
+      if (csv_vector.length() && parser.builder_.GetSize() &&
+          parser.root_struct_def_) {
+        auto out_name = output_path + filebase +
+                        (csv_separator == ',' ? ".csv" : ".tsv");
+        if (print_make_rules) {
+          printf("%s: %s\n", out_name.c_str(), file_it->c_str());
+        } else {
+          flatbuffers::EnsureDirExists(output_path);
+          auto file = fopen(out_name.c_str(), "w");
+          if (!file) Error("unable to write file " + out_name);
+          std::string err;
+          if (!flatbuffers::GenerateCsv(parser,
+                                        parser.builder_.GetBufferPointer(),
+                                        csv_vector, csv_columns,
+                                        csv_separator, opts,
+                                        [file](const char *text, size_t len) {
+                return fwrite(text, 1, len, file) == len;
+              }, &err))
+            Error(*file_it + ": " + err, false, false);
+          if (fclose(file)) Error("unable to write file " + out_name);
+        }
+      }
+
       if (proto_mode) GenerateFBS(parser, output_path, filebase, opts);
 
       // We do not want to generate code for the definitions in this file
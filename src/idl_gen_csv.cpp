@@ -0,0 +1,266 @@
+/*
+ * Copyright 2015 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Flattens a vector of tables or structs into CSV or TSV rows.
+
+#include "flatbuffers/flatbuffers.h"
+#include "flatbuffers/idl.h"
+#include "flatbuffers/util.h"
+
+namespace flatbuffers {
+
+// Rows are handed to the sink in pieces of about this size.
+static const size_t kCsvFlushSize = 1 << 16;
+
+namespace {
+
+// How to get from a row to the value of one of its columns.
+struct CsvColumn {
+  CsvColumn() : default_int(0), default_float(0) {}
+
+  std::string name;
+  // Each a field of the struct or table the one before refers to, ending
+  // in a scalar or string.
+  std::vector<const FieldDef *> fields;
+  int64_t default_int;  // The default of the last field, if scalar.
+  double default_float;
+};
+
+}  // namespace
+
+// Finds the fields named by "path", separated by ".", starting in
+// "struct_def", each of which but the last must be a struct or table.
+static bool ResolveFieldPath(const StructDef &struct_def,
+                             const std::string &path,
+                             std::vector<const FieldDef *> *fields,
+                             std::string *error) {
+  auto sd = &struct_def;
+  for (size_t start = 0; ; ) {
+    auto end = path.find('.', start);
+    auto name = path.substr(start, end == std::string::npos
+                                     ? std::string::npos : end - start);
+    if (!sd) {
+      *error = "can't select " + name + " from " + fields->back()->name +
+               ", it isn't a table or struct";
+      return false;
+    }
+    auto fd = sd->fields.Lookup(name);
+    if (!fd) {
+      *error = "unknown field: " + name + " in " + sd->name;
+      return false;
+    }
+    fields->push_back(fd);
+    sd = fd->value.type.base_type == BASE_TYPE_STRUCT
+      ? fd->value.type.struct_def
+      : nullptr;
+    if (end == std::string::npos) return true;
+    start = end + 1;
+  }
+}
+
+static bool IsCsvValue(const Type &type) {
+  return IsScalar(type.base_type) || type.base_type == BASE_TYPE_STRING;
+}
+
+// All scalars and strings of "struct_def", and of the structs in it.
+static void AddDefaultColumns(const StructDef &struct_def,
+                              const std::string &prefix,
+                              std::vector<const FieldDef *> *fields,
+                              std::vector<CsvColumn> *columns) {
+  for (auto it = struct_def.fields.vec.begin();
+       it != struct_def.fields.vec.end(); ++it) {
+    auto &fd = **it;
+    if (fd.deprecated) continue;
+    fields->push_back(&fd);
+    if (IsCsvValue(fd.value.type)) {
+      columns->push_back(CsvColumn());
+      columns->back().name = prefix + fd.name;
+      columns->back().fields = *fields;
+    } else if (IsStruct(fd.value.type)) {
+      AddDefaultColumns(*fd.value.type.struct_def, prefix + fd.name + ".",
+                        fields, columns);
+    }
+    fields->pop_back();
+  }
+}
+
+// Quotes "str" if it holds anything that would otherwise end the value.
+static void AppendCsvString(const char *str, size_t len, char separator,
+                            std::string *text) {
+  auto end = str + len;
+  auto plain = std::find_if(str, end, [separator](char c) {
+    return c == separator || c == '\"' || c == '\n' || c == '\r';
+  }) == end;
+  if (plain) {
+    text->append(str, len);
+    return;
+  }
+  *text += '\"';
+  for (auto p = str; p < end; ) {
+    auto quote = std::find(p, end, '\"');
+    text->append(p, quote);
+    if (quote == end) break;
+    *text += "\"\"";
+    p = quote + 1;
+  }
+  *text += '\"';
+}
+
+template<typename T> static void AppendCsvScalar(T val, const Type &type,
+                                                 const GeneratorOptions &opts,
+                                                 std::string *text) {
+  if (type.enum_def && opts.output_enum_identifiers) {
+    auto enum_val = type.enum_def->ReverseLookup(static_cast<int>(val));
+    if (enum_val) {
+      *text += enum_val->name;
+      return;
+    }
+  }
+  if (type.base_type == BASE_TYPE_BOOL) {
+    *text += val ? "true" : "false";
+  } else {
+    char buf[kNumToCharsBufferSize];
+    text->append(buf, NumToChars(val, buf));
+  }
+}
+
+// Appends the value of "column" for "row" (a struct if "fixed"), or nothing
+// if any of the tables or strings on the way to it are absent.
+static void AppendCsvColumn(const CsvColumn &column, const uint8_t *row,
+                            bool fixed, char separator,
+                            const GeneratorOptions &opts,
+                            std::string *text) {
+  auto p = row;
+  for (size_t i = 0; i + 1 < column.fields.size(); i++) {
+    auto &fd = *column.fields[i];
+    if (fixed) {
+      p += fd.value.offset;
+    } else {
+      auto table = reinterpret_cast<const Table *>(p);
+      fixed = IsStruct(fd.value.type);
+      p = fixed ? table->GetStruct<const uint8_t *>(fd.value.offset)
+                : table->GetPointer<const uint8_t *>(fd.value.offset);
+      if (!p) return;
+    }
+  }
+  auto &fd = *column.fields.back();
+  auto &type = fd.value.type;
+  auto table = reinterpret_cast<const Table *>(p);
+  switch (type.base_type) {
+    #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, PTYPE) \
+      case BASE_TYPE_ ## ENUM: \
+        AppendCsvScalar<CTYPE>(fixed \
+          ? ReadScalar<CTYPE>(p + fd.value.offset) \
+          : table->GetField<CTYPE>(fd.value.offset, \
+              IsFloat(type.base_type) \
+                ? static_cast<CTYPE>(column.default_float) \
+                : static_cast<CTYPE>(column.default_int)), \
+          type, opts, text); \
+        break;
+      FLATBUFFERS_GEN_TYPES_SCALAR(FLATBUFFERS_TD)
+    #undef FLATBUFFERS_TD
+    case BASE_TYPE_STRING: {
+      auto str = table->GetPointer<const String *>(fd.value.offset);
+      if (str) AppendCsvString(str->c_str(), str->size(), separator, text);
+      break;
+    }
+    default: assert(0);
+  }
+}
+
+bool GenerateCsv(const Parser &parser, const void *flatbuffer,
+                 const std::string &vector_path,
+                 const std::vector<std::string> &column_paths,
+                 char separator, const GeneratorOptions &opts,
+                 const TextSink &sink, std::string *error) {
+  assert(parser.root_struct_def_);  // call SetRootType()
+  // Find the vector, and check the columns fit its elements, before
+  // looking at any data.
+  std::vector<const FieldDef *> vector_fields;
+  if (!ResolveFieldPath(*parser.root_struct_def_, vector_path,
+                        &vector_fields, error))
+    return false;
+  auto &vector_type = vector_fields.back()->value.type;
+  if (vector_type.base_type != BASE_TYPE_VECTOR ||
+      vector_type.element != BASE_TYPE_STRUCT) {
+    *error = vector_path + " isn't a vector of tables or structs";
+    return false;
+  }
+  auto &row_def = *vector_type.struct_def;
+  std::vector<CsvColumn> columns;
+  if (column_paths.empty()) {
+    std::vector<const FieldDef *> fields;
+    AddDefaultColumns(row_def, "", &fields, &columns);
+  }
+  for (auto it = column_paths.begin(); it != column_paths.end(); ++it) {
+    columns.push_back(CsvColumn());
+    auto &column = columns.back();
+    column.name = *it;
+    if (!ResolveFieldPath(row_def, *it, &column.fields, error)) return false;
+    auto &type = column.fields.back()->value.type;
+    if (!IsCsvValue(type)) {
+      *error = "column " + *it + " isn't a scalar or string";
+      return false;
+    }
+  }
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    auto &value = it->fields.back()->value;
+    if (IsFloat(value.type.base_type))
+      it->default_float = StringToFloat<double>(value.constant.c_str());
+    else
+      it->default_int = StringToInt(value.constant.c_str());
+  }
+
+  std::string text;
+  text.reserve(kCsvFlushSize * 2);
+  auto flush = [&](size_t min_size) {
+    if (text.length() < min_size) return true;
+    auto ok = !text.length() || sink(text.c_str(), text.length());
+    text.clear();
+    if (!ok) *error = "unable to write output";
+    return ok;
+  };
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    if (it != columns.begin()) text += separator;
+    AppendCsvString(it->name.c_str(), it->name.length(), separator, &text);
+  }
+  text += '\n';
+
+  // Tables on the way to the vector may be absent, leaving no rows.
+  auto table = GetRoot<Table>(flatbuffer);
+  for (auto it = vector_fields.begin(); it + 1 < vector_fields.end() && table;
+       ++it)
+    table = table->GetPointer<const Table *>((*it)->value.offset);
+  auto vec = table
+    ? table->GetPointer<const Vector<uint8_t> *>(
+        vector_fields.back()->value.offset)
+    : nullptr;
+  for (uoffset_t i = 0; vec && i < vec->size(); i++) {
+    auto row = row_def.fixed
+      ? vec->Data() + i * row_def.bytesize
+      : reinterpret_cast<const uint8_t *>(
+          reinterpret_cast<const Vector<Offset<Table>> *>(vec)->Get(i));
+    for (auto it = columns.begin(); it != columns.end(); ++it) {
+      if (it != columns.begin()) text += separator;
+      AppendCsvColumn(*it, row, row_def.fixed, separator, opts, &text);
+    }
+    text += '\n';
+    if (!flush(kCsvFlushSize)) return false;
+  }
+  return flush(0);
+}
+
+}  // namespace flatbuffers
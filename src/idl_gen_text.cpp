@@ -20,11 +20,46 @@
 #include "flatbuffers/idl.h"
 #include "flatbuffers/util.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(FLATBUFFERS_NO_SIMD)
+  #define FLATBUFFERS_SSE2_TEXT
+  #include <emmintrin.h>
+#endif
+
 namespace flatbuffers {
 
+// When streaming, text is handed to the sink in pieces of about this size.
+static const size_t kTextFlushSize = 1 << 16;
+
+// Vectors of tables are generated in parallel in chunks of this many.
+static const uoffset_t kTextChunkElements = 256;
+
+// Where text is generated to: appended to "text", which, when streaming, is
+// handed to "sink" and emptied whenever Flush() finds enough of it.
+struct TextOutput {
+  TextOutput(std::string *_text, const TextSink *_sink)
+    : text(*_text), sink(_sink), ok(true), worker(false) {}
+
+  // Call only in between values, or within strings, where no text still
+  // needs to be changed.
+  void Flush(size_t min_size = kTextFlushSize) {
+    if (!sink || text.length() < min_size) return;
+    if (ok && text.length()) ok = (*sink)(text.c_str(), text.length());
+    text.clear();
+  }
+
+  std::string &text;
+  const TextSink *sink;  // nullptr if not streaming.
+  bool ok;  // Until the sink fails, after which generating can stop.
+  bool worker;  // Generating part of a vector on a thread of its own.
+};
+
 static void GenStruct(const StructDef &struct_def, const Table *table,
                       int indent, const GeneratorOptions &opts,
-                      std::string *_text);
+                      TextOutput *out);
 
 // If indentation is less than 0, that indicates we don't want any newlines
 // either.
@@ -38,8 +73,8 @@ int Indent(const GeneratorOptions &opts) {
 
 // Output an identifier with or without quotes depending on strictness.
 void OutputIdentifier(const std::string &name, const GeneratorOptions &opts,
-                      std::string *_text) {
-  std::string &text = *_text;
+                      TextOutput *out) {
+  std::string &text = out->text;
   if (opts.strict_json) text += "\"";
   text += name;
   if (opts.strict_json) text += "\"";
@@ -51,12 +86,12 @@ void OutputIdentifier(const std::string &name, const GeneratorOptions &opts,
 template<typename T> void Print(T val, Type type, int /*indent*/,
                                 StructDef * /*union_sd*/,
                                 const GeneratorOptions &opts,
-                                std::string *_text) {
-  std::string &text = *_text;
+                                TextOutput *out) {
+  std::string &text = out->text;
   if (type.enum_def && opts.output_enum_identifiers) {
     auto enum_val = type.enum_def->ReverseLookup(static_cast<int>(val));
     if (enum_val) {
-      OutputIdentifier(enum_val->name, opts, _text);
+      OutputIdentifier(enum_val->name, opts, out);
       return;
     }
   }
@@ -64,40 +99,204 @@ template<typename T> void Print(T val, Type type, int /*indent*/,
   if (type.base_type == BASE_TYPE_BOOL) {
     text += val ? "true" : "false";
   } else {
-    text += NumToString(val);
+    char buf[kNumToCharsBufferSize];
+    text.append(buf, NumToChars(val, buf));
   }
 }
 
-// Print a vector a sequence of JSON values, comma separated, wrapped in "[]".
-template<typename T> void PrintVector(const Vector<T> &v, Type type,
-                                      int indent, const GeneratorOptions &opts,
-                                      std::string *_text) {
-  std::string &text = *_text;
-  text += "[";
-  text += NewLine(opts);
-  for (uoffset_t i = 0; i < v.size(); i++) {
+// Print element "i" of a vector as a JSON value.
+template<typename T> void PrintVectorElement(const Vector<T> &v, uoffset_t i,
+                                             Type type, int indent,
+                                             const GeneratorOptions &opts,
+                                             TextOutput *out) {
+  if (IsStruct(type))
+    Print(v.GetStructFromOffset(i * type.struct_def->bytesize), type,
+          indent, nullptr, opts, out);
+  else
+    Print(v[i], type, indent, nullptr, opts, out);
+}
+
+// Print elements "begin" to "end" of a vector as JSON values, comma
+// separated.
+template<typename T> void PrintVectorElements(const Vector<T> &v,
+                                              uoffset_t begin, uoffset_t end,
+                                              Type type, int indent,
+                                              const GeneratorOptions &opts,
+                                              TextOutput *out) {
+  std::string &text = out->text;
+  for (uoffset_t i = begin; i < end && out->ok; i++) {
     if (i) {
       text += ",";
       text += NewLine(opts);
+      out->Flush();
     }
     text.append(indent + Indent(opts), ' ');
-    if (IsStruct(type))
-      Print(v.GetStructFromOffset(i * type.struct_def->bytesize), type,
-            indent + Indent(opts), nullptr, opts, _text);
-    else
-      Print(v[i], type, indent + Indent(opts), nullptr,
-            opts, _text);
+    PrintVectorElement(v, i, type, indent + Indent(opts), opts, out);
   }
+}
+
+// Only vectors of tables are worth generating in parallel.
+template<typename T> bool PrintVectorElementsInParallel(
+    const Vector<T> & /*v*/, Type /*type*/, int /*indent*/,
+    const GeneratorOptions & /*opts*/, TextOutput * /*out*/) {
+  return false;
+}
+
+// Generates chunks of a large vector of tables on opts.num_threads threads,
+// each into text of its own, which is output in order as it completes.
+// Returns false if the vector isn't worth it.
+static bool PrintVectorElementsInParallel(const Vector<Offset<void>> &v,
+                                          Type type, int indent,
+                                          const GeneratorOptions &opts,
+                                          TextOutput *out) {
+  if (out->worker || opts.num_threads == 1 ||
+      type.base_type != BASE_TYPE_STRUCT || type.struct_def->fixed ||
+      v.size() <= kTextChunkElements)
+    return false;
+  size_t num_chunks = (v.size() + kTextChunkElements - 1) / kTextChunkElements;
+  size_t num_threads = opts.num_threads > 0
+    ? opts.num_threads
+    : std::max(1u, std::thread::hardware_concurrency());
+  num_threads = std::min(num_threads, num_chunks);
+  // Workers may run this far ahead of the output.
+  const size_t max_in_flight = 4 * num_threads;
+
+  struct Chunk {
+    Chunk() : done(false) {}
+    std::string text;
+    bool done;
+  };
+  std::vector<Chunk> chunks(num_chunks);
+  std::mutex mutex;
+  std::condition_variable chunk_done, chunk_output;
+  size_t next_chunk = 0;     // To be generated.
+  size_t output_chunks = 0;  // Appended to "out" so far.
+  bool stop = false;
+
+  auto worker = [&]() {
+    for (;;) {
+      size_t chunk;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunk_output.wait(lock, [&]() {
+          return stop || next_chunk < output_chunks + max_in_flight;
+        });
+        if (stop || next_chunk == num_chunks) return;
+        chunk = next_chunk++;
+      }
+      std::string text;
+      TextOutput chunk_out(&text, nullptr);
+      chunk_out.worker = true;
+      auto begin = static_cast<uoffset_t>(chunk * kTextChunkElements);
+      PrintVectorElements(v, begin,
+                          std::min(begin + kTextChunkElements, v.size()),
+                          type, indent, opts, &chunk_out);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks[chunk].text.swap(text);
+        chunks[chunk].done = true;
+      }
+      chunk_done.notify_one();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_threads; i++)
+    threads.push_back(std::thread(worker));
+  for (size_t i = 0; i < num_chunks && out->ok; i++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      chunk_done.wait(lock, [&]() { return chunks[i].done; });
+    }
+    out->text += chunks[i].text;
+    std::string().swap(chunks[i].text);
+    out->Flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      output_chunks = i + 1;
+      stop = !out->ok;
+    }
+    chunk_output.notify_all();
+  }
+  // Workers waiting for room to run ahead must stop, too, when output stops
+  // early (including before the first chunk, if the sink already failed).
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  chunk_output.notify_all();
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+  return true;
+}
+
+// Print a vector a sequence of JSON values, comma separated, wrapped in "[]".
+template<typename T> void PrintVector(const Vector<T> &v, Type type,
+                                      int indent, const GeneratorOptions &opts,
+                                      TextOutput *out) {
+  std::string &text = out->text;
+  text += "[";
+  text += NewLine(opts);
+  if (!PrintVectorElementsInParallel(v, type, indent, opts, out))
+    PrintVectorElements(v, 0, v.size(), type, indent, opts, out);
   text += NewLine(opts);
   text.append(indent, ' ');
   text += "]";
 }
 
-static void EscapeString(const String &s, std::string *_text) {
-  std::string &text = *_text;
+// Whether "c" can appear in a JSON string as is.
+static inline bool IsPlainChar(char c) {
+  return c >= ' ' && c <= '~' && c != '\"' && c != '\\';
+}
+
+// The length of the run of characters at the start of "s" (of "len" bytes)
+// that need no escaping. The SSE2 version checks 16 at a time.
+static size_t PlainRunLength(const char *s, size_t len) {
+  size_t i = 0;
+  #ifdef FLATBUFFERS_SSE2_TEXT
+    const __m128i below = _mm_set1_epi8(' ' - 1), above = _mm_set1_epi8(0x7F),
+                  quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\');
+    for (; i + 16 <= len; i += 16) {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+      // Bytes >= 0x80 are negative, so fail the first compare.
+      auto printable = _mm_and_si128(_mm_cmpgt_epi8(v, below),
+                                     _mm_cmplt_epi8(v, above));
+      auto special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                  _mm_cmpeq_epi8(v, backslash));
+      auto escape = _mm_movemask_epi8(_mm_andnot_si128(special, printable)) ^
+                    0xFFFF;
+      if (escape) return i + __builtin_ctz(escape);
+    }
+  #endif
+  while (i < len && IsPlainChar(s[i])) i++;
+  return i;
+}
+
+// Appends an escape code: a backslash, "kind", then "val" as "digits"
+// uppercase hex digits.
+static void AppendHexEscape(char kind, uint32_t val, int digits,
+                            std::string *text) {
+  static const char kHex[] = "0123456789ABCDEF";
+  char buf[6] = { '\\', kind };
+  for (int i = digits - 1; i >= 0; i--, val >>= 4) buf[2 + i] = kHex[val & 15];
+  text->append(buf, 2 + digits);
+}
+
+static void EscapeString(const String &s, TextOutput *out) {
+  std::string &text = out->text;
+  const char *str = s.c_str();
+  const size_t len = s.size();
   text += "\"";
-  for (uoffset_t i = 0; i < s.size(); i++) {
-    char c = s[i];
+  for (size_t i = 0; i < len; ) {
+    // Characters that need no escaping are appended a run at a time (at
+    // most a buffer full when streaming, so long strings needn't be held
+    // all at once either).
+    auto max_run = std::min(len - i, kTextFlushSize);
+    auto run = PlainRunLength(str + i, max_run);
+    text.append(str + i, run);
+    i += run;
+    out->Flush();
+    if (run == max_run) continue;
+    char c = str[i++];
     switch (c) {
       case '\n': text += "\\n"; break;
       case '\t': text += "\\t"; break;
@@ -106,27 +305,22 @@ static void EscapeString(const String &s, std::string *_text) {
       case '\f': text += "\\f"; break;
       case '\"': text += "\\\""; break;
       case '\\': text += "\\\\"; break;
-      default:
-        if (c >= ' ' && c <= '~') {
-          text += c;
+      default: {
+        // Not printable ASCII data. Let's see if it's valid UTF-8 first:
+        const char *utf8 = str + i - 1;
+        int ucc = FromUTF8(&utf8);
+        if (ucc >= 0x80 && ucc <= 0xFFFF) {
+          // Parses as Unicode within JSON's \uXXXX range, so use that.
+          AppendHexEscape('u', ucc, 4, &text);
+          // Skip past characters recognized.
+          i = static_cast<size_t>(utf8 - str);
         } else {
-          // Not printable ASCII data. Let's see if it's valid UTF-8 first:
-          const char *utf8 = s.c_str() + i;
-          int ucc = FromUTF8(&utf8);
-          if (ucc >= 0x80 && ucc <= 0xFFFF) {
-            // Parses as Unicode within JSON's \uXXXX range, so use that.
-            text += "\\u";
-            text += IntToStringHex(ucc, 4);
-            // Skip past characters recognized.
-            i = static_cast<uoffset_t>(utf8 - s.c_str() - 1);
-          } else {
-            // It's either unprintable ASCII, arbitrary binary, or Unicode data
-            // that doesn't fit \uXXXX, so use \xXX escape code instead.
-            text += "\\x";
-            text += IntToStringHex(static_cast<uint8_t>(c), 2);
-          }
+          // It's either unprintable ASCII, arbitrary binary, or Unicode data
+          // that doesn't fit \uXXXX, so use \xXX escape code instead.
+          AppendHexEscape('x', static_cast<uint8_t>(c), 2, &text);
         }
         break;
+      }
     }
   }
   text += "\"";
@@ -137,7 +331,7 @@ template<> void Print<const void *>(const void *val,
                                     Type type, int indent,
                                     StructDef *union_sd,
                                     const GeneratorOptions &opts,
-                                    std::string *_text) {
+                                    TextOutput *out) {
   switch (type.base_type) {
     case BASE_TYPE_UNION:
       // If this assert hits, you have an corrupt buffer, a union type field
@@ -147,21 +341,40 @@ template<> void Print<const void *>(const void *val,
                 reinterpret_cast<const Table *>(val),
                 indent,
                 opts,
-                _text);
+                out);
       break;
     case BASE_TYPE_STRUCT:
       GenStruct(*type.struct_def,
                 reinterpret_cast<const Table *>(val),
                 indent,
                 opts,
-                _text);
+                out);
       break;
     case BASE_TYPE_STRING: {
-      EscapeString(*reinterpret_cast<const String *>(val), _text);
+      EscapeString(*reinterpret_cast<const String *>(val), out);
       break;
     }
     case BASE_TYPE_VECTOR:
       type = type.VectorType();
+      if (opts.base64_byte_vectors && !type.enum_def &&
+          (type.base_type == BASE_TYPE_UCHAR ||
+           type.base_type == BASE_TYPE_CHAR)) {
+        // Encode straight into the text, a piece at a time when streaming
+        // (these must be a multiple of 3 bytes, to not pad in between).
+        auto &v = *reinterpret_cast<const Vector<uint8_t> *>(val);
+        auto &text = out->text;
+        const size_t piece = out->sink ? kTextFlushSize / 8 * 3 : v.size();
+        text += '\"';
+        for (size_t i = 0; i < v.size() && out->ok; i += piece) {
+          auto len = std::min(piece, v.size() - i);
+          auto start = text.length();
+          text.resize(start + Base64EncodedSize(len));
+          Base64Encode(v.data() + i, len, &text[start]);
+          out->Flush();
+        }
+        text += '\"';
+        break;
+      }
       // Call PrintVector above specifically for each element type:
       switch (type.base_type) {
         #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, \
@@ -169,7 +382,7 @@ template<> void Print<const void *>(const void *val,
           case BASE_TYPE_ ## ENUM: \
             PrintVector<CTYPE>( \
               *reinterpret_cast<const Vector<CTYPE> *>(val), \
-              type, indent, opts, _text); break;
+              type, indent, opts, out); break;
           FLATBUFFERS_GEN_TYPES(FLATBUFFERS_TD)
         #undef FLATBUFFERS_TD
       }
@@ -181,19 +394,19 @@ template<> void Print<const void *>(const void *val,
 // Generate text for a scalar field.
 template<typename T> static void GenField(const FieldDef &fd,
                                           const Table *table, bool fixed,
+                                          int indent, StructDef * /*union_sd*/,
                                           const GeneratorOptions &opts,
-                                          int indent,
-                                          std::string *_text) {
+                                          TextOutput *out) {
   Print(fixed ?
     reinterpret_cast<const Struct *>(table)->GetField<T>(fd.value.offset) :
     table->GetField<T>(fd.value.offset, 0), fd.value.type, indent, nullptr,
-                                            opts, _text);
+                                            opts, out);
 }
 
 // Generate text for non-scalar field.
 static void GenFieldOffset(const FieldDef &fd, const Table *table, bool fixed,
                            int indent, StructDef *union_sd,
-                           const GeneratorOptions &opts, std::string *_text) {
+                           const GeneratorOptions &opts, TextOutput *out) {
   const void *val = nullptr;
   if (fixed) {
     // The only non-scalar fields in structs are structs.
@@ -205,54 +418,84 @@ static void GenFieldOffset(const FieldDef &fd, const Table *table, bool fixed,
       ? table->GetStruct<const void *>(fd.value.offset)
       : table->GetPointer<const void *>(fd.value.offset);
   }
-  Print(val, fd.value.type, indent, union_sd, opts, _text);
+  Print(val, fd.value.type, indent, union_sd, opts, out);
+}
+
+typedef void (*GenFieldFunction)(const FieldDef &fd, const Table *table,
+                                 bool fixed, int indent, StructDef *union_sd,
+                                 const GeneratorOptions &opts,
+                                 TextOutput *out);
+
+// GenField or GenFieldOffset for the type of "fd".
+static GenFieldFunction GetGenField(const FieldDef &fd) {
+  switch (fd.value.type.base_type) {
+    #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, PTYPE) \
+      case BASE_TYPE_ ## ENUM: return GenField<CTYPE>;
+      FLATBUFFERS_GEN_TYPES_SCALAR(FLATBUFFERS_TD)
+    #undef FLATBUFFERS_TD
+    default: return GenFieldOffset;
+  }
+}
+
+// Everything about generating text for a struct or table that doesn't depend
+// on the data, so only the data needs looking at for each object.
+struct StructDef::TextPlan {
+  struct Field {
+    const FieldDef *def;
+    std::string key[2];  // The name and ": ", without and with quotes.
+    GenFieldFunction gen;
+    bool default_scalar;  // Output if absent with default scalars enabled.
+  };
+  std::vector<Field> fields;  // In the order to output them.
+};
+
+static const StructDef::TextPlan &GetTextPlan(const StructDef &struct_def) {
+  std::call_once(struct_def.text_plan_once, [&struct_def]() {
+    auto plan = std::make_shared<StructDef::TextPlan>();
+    for (auto it = struct_def.fields.vec.begin();
+         it != struct_def.fields.vec.end(); ++it) {
+      const FieldDef &fd = **it;
+      StructDef::TextPlan::Field field;
+      field.def = &fd;
+      field.key[0] = fd.name + ": ";
+      field.key[1] = "\"" + fd.name + "\": ";
+      field.gen = GetGenField(fd);
+      field.default_scalar = IsScalar(fd.value.type.base_type) &&
+                             !fd.deprecated;
+      plan->fields.push_back(field);
+    }
+    struct_def.text_plan = plan;
+  });
+  return *struct_def.text_plan;
 }
 
 // Generate text for a struct or table, values separated by commas, indented,
 // and bracketed by "{}"
 static void GenStruct(const StructDef &struct_def, const Table *table,
                       int indent, const GeneratorOptions &opts,
-                      std::string *_text) {
-  std::string &text = *_text;
+                      TextOutput *out) {
+  std::string &text = out->text;
+  auto &plan = GetTextPlan(struct_def);
   text += "{";
   int fieldout = 0;
   StructDef *union_sd = nullptr;
-  for (auto it = struct_def.fields.vec.begin();
-       it != struct_def.fields.vec.end();
+  for (auto it = plan.fields.begin(); it != plan.fields.end() && out->ok;
        ++it) {
-    FieldDef &fd = **it;
+    const FieldDef &fd = *it->def;
     auto is_present = struct_def.fixed || table->CheckField(fd.value.offset);
     auto output_anyway = opts.output_default_scalars_in_json &&
-                         IsScalar(fd.value.type.base_type) &&
-                         !fd.deprecated;
+                         it->default_scalar;
     if (is_present || output_anyway) {
       if (fieldout++) {
         text += ",";
+        out->Flush();
       }
       text += NewLine(opts);
       text.append(indent + Indent(opts), ' ');
-      OutputIdentifier(fd.name, opts, _text);
-      text += ": ";
+      text += it->key[opts.strict_json];
       if (is_present) {
-        switch (fd.value.type.base_type) {
-           #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, \
-             PTYPE) \
-             case BASE_TYPE_ ## ENUM: \
-                GenField<CTYPE>(fd, table, struct_def.fixed, \
-                                opts, indent + Indent(opts), _text); \
-                break;
-            FLATBUFFERS_GEN_TYPES_SCALAR(FLATBUFFERS_TD)
-          #undef FLATBUFFERS_TD
-          // Generate drop-thru case statements for all pointer types:
-          #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, \
-            PTYPE) \
-            case BASE_TYPE_ ## ENUM:
-            FLATBUFFERS_GEN_TYPES_POINTER(FLATBUFFERS_TD)
-          #undef FLATBUFFERS_TD
-              GenFieldOffset(fd, table, struct_def.fixed, indent + Indent(opts),
-                             union_sd, opts, _text);
-              break;
-        }
+        it->gen(fd, table, struct_def.fixed, indent + Indent(opts), union_sd,
+                opts, out);
         if (fd.value.type.base_type == BASE_TYPE_UTYPE) {
           auto enum_val = fd.value.type.enum_def->ReverseLookup(
                                   table->GetField<uint8_t>(fd.value.offset, 0));
@@ -271,20 +514,308 @@ static void GenStruct(const StructDef &struct_def, const Table *table,
   text += "}";
 }
 
-// Generate a text representation of a flatbuffer in JSON format.
-void GenerateText(const Parser &parser, const void *flatbuffer,
-                  const GeneratorOptions &opts, std::string *_text) {
-  std::string &text = *_text;
+// A path selecting part of a buffer, see GenerateTextAtPath().
+struct TextPath {
+  struct Step {
+    Step() : range(false), begin(0), end(0) {}
+    std::string field;  // Empty if this indexes a vector.
+    bool range;         // [begin:end] rather than [begin].
+    int64_t begin, end;  // Negative counts from the end, as does an open end
+                         // of a range, which is INT64_MIN.
+  };
+
+  TextPath(const GeneratorOptions &_opts, TextOutput *_out,
+           std::string *_error)
+    : opts(_opts), out(_out), error(_error) {}
+
+  bool Parse(const std::string &path, const StructDef &root);
+  bool Fits(const Type &type, const std::string &name, size_t step,
+            std::string *why) const;
+  bool GenStruct(const StructDef &struct_def, const Table *table,
+                 size_t step, int indent);
+  bool GenVector(const Type &type, const void *vec, size_t step, int indent);
+  bool GenElement(const Type &type, const void *vec, uoffset_t i,
+                  size_t step, int indent);
+  bool Fail(const std::string &msg) {
+    *error = msg;
+    return false;
+  }
+
+  std::vector<Step> steps;
+  const GeneratorOptions &opts;
+  TextOutput *out;
+  std::string *error;
+};
+
+// Fields are separated by ".", and followed by any number of "[i]" or
+// "[begin:end]". The whole path must fit the schema starting at "root",
+// whatever the data turns out to hold.
+bool TextPath::Parse(const std::string &path, const StructDef &root) {
+  for (auto p = path.c_str(); *p; ) {
+    Step step;
+    if (*p == '[') {
+      if (steps.empty()) return Fail("path must start with a field: " + path);
+      p++;
+      auto number = [&](int64_t *val) {
+        auto start = p;
+        *val = StringToInt(start, 10, &p);
+        return p != start;
+      };
+      auto has_begin = number(&step.begin);
+      if (*p == ':') {
+        p++;
+        step.range = true;
+        step.end = INT64_MIN;
+        if (*p != ']' && !number(&step.end))
+          return Fail("invalid index in path: " + path);
+      } else if (!has_begin) {
+        return Fail("invalid index in path: " + path);
+      }
+      if (*p++ != ']') return Fail("missing ] in path: " + path);
+    } else {
+      if (steps.size() && *p++ != '.')
+        return Fail("missing . in path: " + path);
+      while (isalnum(static_cast<unsigned char>(*p)) || *p == '_')
+        step.field += *p++;
+      if (step.field.empty()) return Fail("missing field in path: " + path);
+    }
+    steps.push_back(step);
+  }
+  return Fits(Type(BASE_TYPE_STRUCT, const_cast<StructDef *>(&root)),
+              root.name, 0, error);
+}
+
+// Whether steps from "step" onwards can select from a value of "type",
+// called "name", or else why not. A union fits if any of its members does.
+bool TextPath::Fits(const Type &type, const std::string &name, size_t step,
+                    std::string *why) const {
+  if (step == steps.size()) return true;
+  auto &field = steps[step].field;
+  if (field.empty()) {
+    if (type.base_type == BASE_TYPE_VECTOR)
+      return Fits(type.VectorType(), "an element of " + name, step + 1, why);
+    *why = "can't index " + name + ", it isn't a vector";
+    return false;
+  }
+  switch (type.base_type) {
+    case BASE_TYPE_STRUCT: {
+      auto fd = type.struct_def->fields.Lookup(field);
+      if (!fd) {
+        *why = "unknown field: " + field + " in " + type.struct_def->name;
+        return false;
+      }
+      return Fits(fd->value.type, field, step + 1, why);
+    }
+    case BASE_TYPE_UNION: {
+      std::string first_why;
+      auto &vals = type.enum_def->vals.vec;
+      for (auto it = vals.begin(); it != vals.end(); ++it) {
+        if (!(*it)->struct_def) continue;  // NONE
+        if (Fits(Type(BASE_TYPE_STRUCT, (*it)->struct_def), name, step,
+                 first_why.empty() ? &first_why : why))
+          return true;
+      }
+      *why = first_why.length()
+        ? first_why
+        : "can't select " + field + " from " + name + ", it has no members";
+      return false;
+    }
+    case BASE_TYPE_VECTOR:
+      *why = "can't select " + field + " from a vector, use [i]";
+      return false;
+    default:
+      *why = "can't select " + field + " from " + name +
+             ", it is a scalar or string";
+      return false;
+  }
+}
+
+// Generates text for what steps from "step" onwards select in "table".
+bool TextPath::GenStruct(const StructDef &struct_def, const Table *table,
+                         size_t step, int indent) {
+  if (step == steps.size()) {
+    ::flatbuffers::GenStruct(struct_def, table, indent, opts, out);
+    return true;
+  }
+  // Parse() checked the path fits the schema.
+  auto &name = steps[step].field;
+  auto fd = struct_def.fields.Lookup(name);
+  auto &type = fd->value.type;
+  StructDef *union_sd = nullptr;
+  if (type.base_type == BASE_TYPE_UNION) {
+    auto type_fd = struct_def.fields.Lookup(name + "_type");
+    auto enum_val = type_fd && table->CheckField(type_fd->value.offset)
+      ? type.enum_def->ReverseLookup(
+          table->GetField<uint8_t>(type_fd->value.offset, 0))
+      : nullptr;
+    if (enum_val) union_sd = enum_val->struct_def;
+  }
+  if (!struct_def.fixed && !table->CheckField(fd->value.offset)) {
+    // Absent, like an absent union member or vector, so there's nothing to
+    // select from it either.
+    if (!IsScalar(type.base_type)) {
+      out->text += "null";
+    } else if (type.enum_def) {
+      Print(StringToInt(fd->value.constant.c_str()), type, indent, nullptr,
+            opts, out);
+    } else {
+      out->text += fd->value.constant;
+    }
+    return true;
+  }
+  if (step + 1 == steps.size()) {
+    GetGenField(*fd)(*fd, table, struct_def.fixed, indent, union_sd, opts,
+                     out);
+    return true;
+  }
+  switch (type.base_type) {
+    case BASE_TYPE_STRUCT:
+      return GenStruct(*type.struct_def,
+                       struct_def.fixed
+                         ? reinterpret_cast<const Struct *>(table)->
+                             GetStruct<const Table *>(fd->value.offset)
+                         : IsStruct(type)
+                           ? table->GetStruct<const Table *>(fd->value.offset)
+                           : table->GetPointer<const Table *>(
+                               fd->value.offset),
+                       step + 1, indent);
+    case BASE_TYPE_UNION: {
+      // The member held may not be one the rest of the path fits.
+      std::string why;
+      if (!union_sd ||
+          !Fits(Type(BASE_TYPE_STRUCT, union_sd), name, step + 1, &why)) {
+        out->text += "null";
+        return true;
+      }
+      return GenStruct(*union_sd,
+                       table->GetPointer<const Table *>(fd->value.offset),
+                       step + 1, indent);
+    }
+    default:
+      return GenVector(type.VectorType(),
+                       table->GetPointer<const void *>(fd->value.offset),
+                       step + 1, indent);
+  }
+}
+
+// Generates text for what steps from "step" onwards select in vector "vec" of
+// elements of "type".
+bool TextPath::GenVector(const Type &type, const void *vec, size_t step,
+                         int indent) {
+  auto &s = steps[step];
+  auto size = static_cast<int64_t>(
+                reinterpret_cast<const Vector<uint8_t> *>(vec)->size());
+  auto begin = s.begin < 0 ? s.begin + size : s.begin;
+  if (!s.range) {
+    if (begin < 0 || begin >= size)
+      return Fail("index " + NumToString(s.begin) +
+                  " out of range for vector of size " + NumToString(size));
+    return GenElement(type, vec, static_cast<uoffset_t>(begin), step + 1,
+                      indent);
+  }
+  auto end = s.end == INT64_MIN ? size : s.end < 0 ? s.end + size : s.end;
+  begin = std::max(begin, static_cast<int64_t>(0));
+  end = std::min(end, size);
+  auto &text = out->text;
+  text += "[";
+  text += NewLine(opts);
+  for (auto i = begin; i < end && out->ok; i++) {
+    if (i > begin) {
+      text += ",";
+      text += NewLine(opts);
+      out->Flush();
+    }
+    text.append(indent + Indent(opts), ' ');
+    if (!GenElement(type, vec, static_cast<uoffset_t>(i), step + 1,
+                    indent + Indent(opts)))
+      return false;
+  }
+  text += NewLine(opts);
+  text.append(indent, ' ');
+  text += "]";
+  return true;
+}
+
+// Generates text for what steps from "step" onwards select in element "i" of
+// vector "vec" of elements of "type".
+bool TextPath::GenElement(const Type &type, const void *vec, uoffset_t i,
+                          size_t step, int indent) {
+  if (step < steps.size()) {
+    return GenStruct(*type.struct_def,
+                     IsStruct(type)
+                       ? reinterpret_cast<const Table *>(
+                           reinterpret_cast<const Vector<uint8_t> *>(vec)->
+                             GetStructFromOffset(i * type.struct_def->bytesize))
+                       : reinterpret_cast<const Vector<Offset<Table>> *>(vec)->
+                           Get(i),
+                     step, indent);
+  }
+  switch (type.base_type) {
+    #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, PTYPE) \
+      case BASE_TYPE_ ## ENUM: \
+        PrintVectorElement(*reinterpret_cast<const Vector<CTYPE> *>(vec), i, \
+                           type, indent, opts, out); \
+        break;
+      FLATBUFFERS_GEN_TYPES(FLATBUFFERS_TD)
+    #undef FLATBUFFERS_TD
+  }
+  return true;
+}
+
+static void GenerateText(const Parser &parser, const void *flatbuffer,
+                         const GeneratorOptions &opts, TextOutput *out) {
+  std::string &text = out->text;
   assert(parser.root_struct_def_);  // call SetRootType()
-  text.reserve(1024);   // Reduce amount of inevitable reallocs.
   GenStruct(*parser.root_struct_def_,
             GetRoot<Table>(flatbuffer),
             0,
             opts,
-            _text);
+            out);
   text += NewLine(opts);
 }
 
+// Generate a text representation of a flatbuffer in JSON format.
+void GenerateText(const Parser &parser, const void *flatbuffer,
+                  const GeneratorOptions &opts, std::string *_text) {
+  _text->reserve(1024);   // Reduce amount of inevitable reallocs.
+  TextOutput out(_text, nullptr);
+  GenerateText(parser, flatbuffer, opts, &out);
+}
+
+bool GenerateText(const Parser &parser, const void *flatbuffer,
+                  const GeneratorOptions &opts, const TextSink &sink) {
+  std::string text;
+  text.reserve(kTextFlushSize * 2);
+  TextOutput out(&text, &sink);
+  GenerateText(parser, flatbuffer, opts, &out);
+  out.Flush(0);
+  return out.ok;
+}
+
+bool GenerateText(const Parser &parser, const void *flatbuffer,
+                  const GeneratorOptions &opts, FILE *file) {
+  return GenerateText(parser, flatbuffer, opts,
+                      [file](const char *text, size_t length) {
+    return fwrite(text, 1, length, file) == length;
+  });
+}
+
+bool GenerateTextAtPath(const Parser &parser, const void *flatbuffer,
+                        const std::string &path, const GeneratorOptions &opts,
+                        std::string *_text, std::string *error) {
+  assert(parser.root_struct_def_);  // call SetRootType()
+  std::string text;
+  TextOutput out(&text, nullptr);
+  TextPath text_path(opts, &out, error);
+  if (!text_path.Parse(path, *parser.root_struct_def_) ||
+      !text_path.GenStruct(*parser.root_struct_def_,
+                           GetRoot<Table>(flatbuffer), 0, 0))
+    return false;
+  text += NewLine(opts);
+  *_text += text;
+  return true;
+}
+
 std::string TextFileName(const std::string &path,
                          const std::string &file_name) {
   return path + file_name + ".json";
@@ -295,12 +826,12 @@ bool GenerateTextFile(const Parser &parser,
                       const std::string &file_name,
                       const GeneratorOptions &opts) {
   if (!parser.builder_.GetSize() || !parser.root_struct_def_) return true;
-  std::string text;
-  GenerateText(parser, parser.builder_.GetBufferPointer(), opts,
-               &text);
-  return flatbuffers::SaveFile(TextFileName(path, file_name).c_str(),
-                               text,
-                               false);
+  // Stream the text, rather than holding all of it in memory.
+  auto file = fopen(TextFileName(path, file_name).c_str(), "w");
+  if (!file) return false;
+  auto ok = GenerateText(parser, parser.builder_.GetBufferPointer(), opts,
+                         file);
+  return fclose(file) == 0 && ok;
 }
 
 std::string TextMakeRule(const Parser &parser,
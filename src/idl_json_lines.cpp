@@ -0,0 +1,157 @@
+/*
+ * Copyright 2015 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Parallel conversion of newline-delimited JSON to binary.
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "flatbuffers/flatbuffers.h"
+#include "flatbuffers/idl.h"
+
+namespace flatbuffers {
+
+// Chunks are cut at the first line boundary after this many bytes.
+static const size_t kJsonLinesChunkSize = 1 << 16;
+// Each size prefixed buffer is padded to a multiple of this, the largest
+// alignment anything in a buffer may need (see force_align).
+static const size_t kJsonLinesAlign = 16;
+
+namespace {
+
+struct JsonLinesChunk {
+  JsonLinesChunk(const char *b, const char *e, int l)
+    : begin(b), end(e), line(l), done(false) {}
+
+  const char *begin, *end;
+  int line;  // Of the first line in this chunk.
+  std::vector<uint8_t> buffers;  // Size prefixed, one per line.
+  std::string error;
+  bool done;
+};
+
+}  // namespace
+
+bool ParseJsonLines(
+    const Parser &schema, const char *source, size_t length,
+    const char *source_filename,
+    const std::function<void(const uint8_t *, size_t)> &output,
+    std::string *error, int num_threads) {
+  // Cut the input up front, counting lines to report errors with.
+  std::vector<JsonLinesChunk> chunks;
+  auto source_end = source + length;
+  int line = 1;
+  for (auto begin = source; begin < source_end; ) {
+    auto end = source_end;
+    if (static_cast<size_t>(source_end - begin) > kJsonLinesChunkSize) {
+      auto nl = std::find(begin + kJsonLinesChunkSize, source_end, '\n');
+      if (nl != source_end) end = nl + 1;
+    }
+    chunks.push_back(JsonLinesChunk(begin, end, line));
+    line += static_cast<int>(std::count(begin, end, '\n'));
+    begin = end;
+  }
+
+  if (num_threads <= 0)
+    num_threads = std::max(1, static_cast<int>(
+                                std::thread::hardware_concurrency()));
+  num_threads = std::min(num_threads, static_cast<int>(chunks.size()));
+  // Workers may run this far ahead of the output.
+  const size_t max_in_flight = 2 * num_threads;
+
+  std::mutex mutex;
+  std::condition_variable chunk_done, chunk_output;
+  size_t next_chunk = 0;    // To be parsed.
+  size_t output_chunks = 0;  // Passed to "output" so far.
+  bool stop = false;
+
+  auto worker = [&]() {
+    Parser parser(&schema);
+    for (;;) {
+      JsonLinesChunk *chunk;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunk_output.wait(lock, [&]() {
+          return stop || next_chunk < output_chunks + max_in_flight;
+        });
+        if (stop || next_chunk == chunks.size()) return;
+        chunk = &chunks[next_chunk++];
+      }
+      parser.StartJsonStream(chunk->begin, chunk->end - chunk->begin,
+                             source_filename, chunk->line);
+      auto header = sizeof(uoffset_t) +
+                    (parser.file_identifier_.length()
+                       ? FlatBufferBuilder::kFileIdentifierLength : 0);
+      while (parser.ParseNextJson()) {
+        // Lay the buffer out as if finished with a size prefix: padding
+        // after the root offset and file identifier keeps everything after
+        // them as aligned (relative to the end of the buffer, which is what
+        // the builder aligns to) as before, with the size prefix included.
+        auto size = parser.builder_.GetSize();
+        auto buf = parser.builder_.GetBufferPointer();
+        auto pad = PaddingBytes(sizeof(uoffset_t) + size, kJsonLinesAlign);
+        auto start = chunk->buffers.size();
+        chunk->buffers.resize(start + sizeof(uoffset_t) + size + pad);
+        auto record = &chunk->buffers[start];
+        WriteScalar(record, static_cast<uoffset_t>(size + pad));
+        WriteScalar(record + sizeof(uoffset_t),
+                    static_cast<uoffset_t>(ReadScalar<uoffset_t>(buf) + pad));
+        memcpy(record + 2 * sizeof(uoffset_t), buf + sizeof(uoffset_t),
+               header - sizeof(uoffset_t));
+        memcpy(record + sizeof(uoffset_t) + header + pad, buf + header,
+               size - header);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunk->error = parser.error_;
+        chunk->done = true;
+      }
+      chunk_done.notify_one();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; i++) threads.push_back(std::thread(worker));
+
+  bool ok = true;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    auto &chunk = chunks[i];
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      chunk_done.wait(lock, [&]() { return chunk.done; });
+    }
+    if (chunk.buffers.size())
+      output(chunk.buffers.data(), chunk.buffers.size());
+    std::vector<uint8_t>().swap(chunk.buffers);
+    if (chunk.error.length()) {
+      *error = chunk.error;
+      ok = false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      output_chunks = i + 1;
+      stop = !ok;
+    }
+    chunk_output.notify_all();
+    if (!ok) break;
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+  return ok;
+}
+
+}  // namespace flatbuffers
@@ -17,6 +17,16 @@
 #include <algorithm>
 #include <list>
 
+#if defined(__SSE2__) && defined(__GNUC__) && !defined(FLATBUFFERS_NO_SIMD)
+  #define FLATBUFFERS_SSE2_TOKENIZER
+  #include <emmintrin.h>
+  // Reads past the end of the source within an aligned block are safe, but
+  // AddressSanitizer can't know that.
+  #define FLATBUFFERS_SCANNER __attribute__((no_sanitize_address))
+#else
+  #define FLATBUFFERS_SCANNER
+#endif
+
 #include "flatbuffers/idl.h"
 #include "flatbuffers/util.h"
 
@@ -67,14 +77,27 @@ template<> inline bool atot<bool>(const char *s) {
   return 0 != atoi(s);
 }
 template<> inline float atot<float>(const char *s) {
-  return static_cast<float>(strtod(s, nullptr));
+  return StringToFloat<float>(s);
 }
 template<> inline double atot<double>(const char *s) {
-  return strtod(s, nullptr);
+  return StringToFloat<double>(s);
 }
 
-template<> inline Offset<void> atot<Offset<void>>(const char *s) {
-  return Offset<void>(atoi(s));
+// Get a value parsed from JSON data as an instance of T.
+template<typename T> inline T ValueAs(ScalarValue val) {
+  return static_cast<T>(val.i);
+}
+template<> inline bool ValueAs<bool>(ScalarValue val) {
+  return val.i != 0;
+}
+template<> inline float ValueAs<float>(ScalarValue val) {
+  return static_cast<float>(val.f);
+}
+template<> inline double ValueAs<double>(ScalarValue val) {
+  return val.f;
+}
+template<> inline Offset<void> ValueAs<Offset<void>>(ScalarValue val) {
+  return Offset<void>(static_cast<uoffset_t>(val.i));
 }
 
 // Declare tokens we'll use. Single character tokens are represented by their
@@ -127,10 +150,90 @@ static std::string TokenToString(int t) {
   }
 }
 
+// Scanners for the tokenizer, which stop at "end" at the latest. The SSE2
+// versions only load 16 byte aligned blocks, which can't cross into an
+// unmapped page even when reading past "end", and step through unaligned
+// leading bytes one at a time.
+
+static inline bool IsJsonSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+#ifdef FLATBUFFERS_SSE2_TOKENIZER
+// Bits for the bytes in a block starting at p that are past "end".
+static inline unsigned PastEndBits(const char *p, const char *end) {
+  return end - p < 16 ? ~((1u << (end - p)) - 1) & 0xFFFF : 0;
+}
+#endif
+
+// Returns the first non-whitespace char at or after p (or end), adding the
+// newlines skipped to *newlines.
+FLATBUFFERS_SCANNER
+static const char *SkipWhitespace(const char *p, const char *end,
+                                  int *newlines) {
+  #ifdef FLATBUFFERS_SSE2_TOKENIZER
+    for (; p < end && reinterpret_cast<uintptr_t>(p) & 15; p++) {
+      if (!IsJsonSpace(*p)) return p;
+      if (*p == '\n') ++*newlines;
+    }
+    for (; p < end; p += 16) {
+      auto block = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+      auto nl = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+      auto space = _mm_or_si128(
+        _mm_or_si128(nl, _mm_cmpeq_epi8(block, _mm_set1_epi8(' '))),
+        _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\t')),
+                     _mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))));
+      auto nl_bits = static_cast<unsigned>(_mm_movemask_epi8(nl));
+      auto other_bits = (~static_cast<unsigned>(_mm_movemask_epi8(space)) &
+                         0xFFFF) | PastEndBits(p, end);
+      if (other_bits) {
+        auto i = __builtin_ctz(other_bits);
+        *newlines += __builtin_popcount(nl_bits & ((1u << i) - 1));
+        return p + i;
+      }
+      *newlines += __builtin_popcount(nl_bits);
+    }
+    return end;
+  #else
+    for (; p < end && IsJsonSpace(*p); p++) {
+      if (*p == '\n') ++*newlines;
+    }
+    return p;
+  #endif
+}
+
+// Returns the first char at or after p inside a string constant that can't
+// be copied as-is: the closing quote, an escape, or a control character.
+// Returns end if there is none.
+FLATBUFFERS_SCANNER
+static const char *ScanStringConstant(const char *p, const char *end) {
+  #ifdef FLATBUFFERS_SSE2_TOKENIZER
+    for (; p < end && reinterpret_cast<uintptr_t>(p) & 15; p++) {
+      if (*p == '\"' || *p == '\\' || (*p >= 0 && *p < ' ')) return p;
+    }
+    for (; p < end; p += 16) {
+      auto block = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+      auto control = _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(0x1F)),
+                                    block);  // Unsigned block <= 0x1F.
+      auto stop = _mm_or_si128(
+        control,
+        _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\"')),
+                     _mm_cmpeq_epi8(block, _mm_set1_epi8('\\'))));
+      auto bits = static_cast<unsigned>(_mm_movemask_epi8(stop)) |
+                  PastEndBits(p, end);
+      if (bits) return p + __builtin_ctz(bits);
+    }
+    return end;
+  #else
+    while (p < end && *p != '\"' && *p != '\\' && (*p < 0 || *p >= ' ')) p++;
+    return p;
+  #endif
+}
+
 // Parses exactly nibbles worth of hex digits into a number, or error.
 int64_t Parser::ParseHexNum(int nibbles) {
   for (int i = 0; i < nibbles; i++)
-    if (!isxdigit(cursor_[i]))
+    if (!isxdigit(static_cast<unsigned char>(PeekChar(i))))
       Error("escape code must be followed by " + NumToString(nibbles) +
             " hex digits");
   std::string target(cursor_, cursor_ + nibbles);
@@ -143,58 +246,65 @@ void Parser::Next() {
   doc_comment_.clear();
   bool seen_newline = false;
   for (;;) {
+    if (cursor_ == end_) { token_ = kTokenEof; return; }
     char c = *cursor_++;
     token_ = c;
     switch (c) {
       case '\0': cursor_--; token_ = kTokenEof; return;
-      case ' ': case '\r': case '\t': break;
-      case '\n': line_++; seen_newline = true; break;
+      case ' ': case '\r': case '\t': case '\n': {
+        int newlines = 0;
+        cursor_ = SkipWhitespace(cursor_ - 1, end_, &newlines);
+        line_ += newlines;
+        if (newlines) seen_newline = true;
+        break;
+      }
       case '{': case '}': case '(': case ')': case '[': case ']': return;
       case ',': case ':': case ';': case '=': return;
       case '.':
-        if(!isdigit(*cursor_)) return;
+        if(!isdigit(static_cast<unsigned char>(PeekChar()))) return;
         Error("floating point constant can\'t start with \".\"");
         break;
       case '\"':
-        attribute_ = "";
-        while (*cursor_ != '\"') {
-          if (*cursor_ < ' ' && *cursor_ >= 0)
+        attribute_.clear();
+        for (;;) {
+          // Copy everything up to the next special char in one go.
+          auto end = ScanStringConstant(cursor_, end_);
+          attribute_.append(cursor_, end);
+          cursor_ = end;
+          if (PeekChar() == '\"') break;
+          if (PeekChar() != '\\')
             Error("illegal character in string constant");
-          if (*cursor_ == '\\') {
-            cursor_++;
-            switch (*cursor_) {
-              case 'n':  attribute_ += '\n'; cursor_++; break;
-              case 't':  attribute_ += '\t'; cursor_++; break;
-              case 'r':  attribute_ += '\r'; cursor_++; break;
-              case 'b':  attribute_ += '\b'; cursor_++; break;
-              case 'f':  attribute_ += '\f'; cursor_++; break;
-              case '\"': attribute_ += '\"'; cursor_++; break;
-              case '\\': attribute_ += '\\'; cursor_++; break;
-              case '/':  attribute_ += '/';  cursor_++; break;
-              case 'x': {  // Not in the JSON standard
-                cursor_++;
-                attribute_ += static_cast<char>(ParseHexNum(2));
-                break;
-              }
-              case 'u': {
-                cursor_++;
-                ToUTF8(static_cast<int>(ParseHexNum(4)), &attribute_);
-                break;
-              }
-              default: Error("unknown escape code in string constant"); break;
+          cursor_++;
+          switch (PeekChar()) {
+            case 'n':  attribute_ += '\n'; cursor_++; break;
+            case 't':  attribute_ += '\t'; cursor_++; break;
+            case 'r':  attribute_ += '\r'; cursor_++; break;
+            case 'b':  attribute_ += '\b'; cursor_++; break;
+            case 'f':  attribute_ += '\f'; cursor_++; break;
+            case '\"': attribute_ += '\"'; cursor_++; break;
+            case '\\': attribute_ += '\\'; cursor_++; break;
+            case '/':  attribute_ += '/';  cursor_++; break;
+            case 'x': {  // Not in the JSON standard
+              cursor_++;
+              attribute_ += static_cast<char>(ParseHexNum(2));
+              break;
             }
-          } else { // printable chars + UTF-8 bytes
-            attribute_ += *cursor_++;
+            case 'u': {
+              cursor_++;
+              ToUTF8(static_cast<int>(ParseHexNum(4)), &attribute_);
+              break;
+            }
+            default: Error("unknown escape code in string constant"); break;
           }
         }
         cursor_++;
         token_ = kTokenStringConstant;
         return;
       case '/':
-        if (*cursor_ == '/') {
+        if (PeekChar() == '/') {
           const char *start = ++cursor_;
-          while (*cursor_ && *cursor_ != '\n' && *cursor_ != '\r') cursor_++;
-          if (*start == '/') {  // documentation comment
+          while (PeekChar() && *cursor_ != '\n' && *cursor_ != '\r') cursor_++;
+          if (start < end_ && *start == '/') {  // documentation comment
             if (cursor_ != source_ && !seen_newline)
               Error("a documentation comment should be on a line on its own");
             doc_comment_.push_back(std::string(start + 1, cursor_));
@@ -206,8 +316,8 @@ void Parser::Next() {
         if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
           // Collect all chars of an identifier:
           const char *start = cursor_ - 1;
-          while (isalnum(static_cast<unsigned char>(*cursor_)) ||
-                 *cursor_ == '_')
+          while (isalnum(static_cast<unsigned char>(PeekChar())) ||
+                 PeekChar() == '_')
             cursor_++;
           attribute_.clear();
           attribute_.append(start, cursor_);
@@ -249,16 +359,16 @@ void Parser::Next() {
           return;
         } else if (isdigit(static_cast<unsigned char>(c)) || c == '-') {
           const char *start = cursor_ - 1;
-          while (isdigit(static_cast<unsigned char>(*cursor_))) cursor_++;
-          if (*cursor_ == '.') {
+          while (isdigit(static_cast<unsigned char>(PeekChar()))) cursor_++;
+          if (PeekChar() == '.') {
             cursor_++;
-            while (isdigit(static_cast<unsigned char>(*cursor_))) cursor_++;
+            while (isdigit(static_cast<unsigned char>(PeekChar()))) cursor_++;
             // See if this float has a scientific notation suffix. Both JSON
-            // and C++ (through strtod() we use) have the same format:
-            if (*cursor_ == 'e' || *cursor_ == 'E') {
+            // and C++ (through StringToFloat() we use) have the same format:
+            if (PeekChar() == 'e' || PeekChar() == 'E') {
               cursor_++;
-              if (*cursor_ == '+' || *cursor_ == '-') cursor_++;
-              while (isdigit(static_cast<unsigned char>(*cursor_))) cursor_++;
+              if (PeekChar() == '+' || PeekChar() == '-') cursor_++;
+              while (isdigit(static_cast<unsigned char>(PeekChar()))) cursor_++;
             }
             token_ = kTokenFloatConstant;
           } else {
@@ -303,9 +413,10 @@ void Parser::ParseNamespacing(std::string *id, std::string *last) {
 }
 
 EnumDef *Parser::LookupEnum(const std::string &id) {
-  auto ed = enums_.Lookup(GetFullyQualifiedName(id));
+  auto &enums = schema_->enums_;
+  auto ed = enums.Lookup(GetFullyQualifiedName(id));
   // id may simply not have a namespace at all, so check that too.
-  if (!ed) ed = enums_.Lookup(id);
+  if (!ed) ed = enums.Lookup(id);
   return ed;
 }
 
@@ -357,7 +468,7 @@ void Parser::ParseType(Type &type) {
 FieldDef &Parser::AddField(StructDef &struct_def,
                            const std::string &name,
                            const Type &type) {
-  auto &field = *new FieldDef();
+  auto &field = *arena_.New<FieldDef>();
   field.value.offset =
     FieldIndexToOffset(static_cast<voffset_t>(struct_def.fields.vec.size()));
   field.name = name;
@@ -475,7 +586,7 @@ void Parser::ParseField(StructDef &struct_def) {
     auto attr = field.attributes.Lookup("id");
     if (attr) {
       auto id = atoi(attr->constant.c_str());
-      auto val = new Value();
+      auto val = arena_.New<Value>();
       val->type = attr->type;
       val->constant = NumToString(id - 1);
       typefield->attributes.Add("id", val);
@@ -485,32 +596,40 @@ void Parser::ParseField(StructDef &struct_def) {
   Expect(';');
 }
 
-void Parser::ParseAnyValue(Value &val, FieldDef *field) {
-  switch (val.type.base_type) {
+ScalarValue Parser::ParseAnyValue(const Type &type, FieldDef *field) {
+  ScalarValue val;
+  switch (type.base_type) {
     case BASE_TYPE_UNION: {
       assert(field);
       if (!field_stack_.size() ||
           field_stack_.back().second->value.type.base_type != BASE_TYPE_UTYPE)
         Error("missing type field before this union value: " + field->name);
-      auto enum_idx = atot<unsigned char>(
-                                    field_stack_.back().first.constant.c_str());
-      auto enum_val = val.type.enum_def->ReverseLookup(enum_idx);
+      auto enum_idx = ValueAs<unsigned char>(field_stack_.back().first);
+      auto enum_val = type.enum_def->ReverseLookup(enum_idx);
       if (!enum_val) Error("illegal type id for: " + field->name);
-      val.constant = NumToString(ParseTable(*enum_val->struct_def));
+      val.i = ParseTable(*enum_val->struct_def);
       break;
     }
     case BASE_TYPE_STRUCT:
-      val.constant = NumToString(ParseTable(*val.type.struct_def));
+      val.i = ParseTable(*type.struct_def);
       break;
     case BASE_TYPE_STRING: {
-      auto s = attribute_;
+      // Check the token before using it, Expect() below moves past it.
+      if (token_ != kTokenStringConstant) Expect(kTokenStringConstant);
+      val.i = builder_.CreateString(attribute_).o;
       Expect(kTokenStringConstant);
-      val.constant = NumToString(builder_.CreateString(s).o);
       break;
     }
     case BASE_TYPE_VECTOR: {
+      auto element = type.VectorType();
+      if (token_ == kTokenStringConstant && !element.enum_def &&
+          (element.base_type == BASE_TYPE_UCHAR ||
+           element.base_type == BASE_TYPE_CHAR)) {
+        val.i = ParseBase64Vector();
+        break;
+      }
       Expect('[');
-      val.constant = NumToString(ParseVector(val.type.VectorType()));
+      val.i = ParseVector(element);
       break;
     }
     case BASE_TYPE_INT:
@@ -519,25 +638,27 @@ void Parser::ParseAnyValue(Value &val, FieldDef *field) {
     case BASE_TYPE_ULONG: {
       if (field && field->attributes.Lookup("hash") &&
           (token_ == kTokenIdentifier || token_ == kTokenStringConstant)) {
-        ParseHash(val, field);
+        val.i = ParseHash(type, field);
       } else {
-        ParseSingleValue(val);
+        val = ParseScalar(type);
       }
       break;
     }
     default:
-      ParseSingleValue(val);
+      val = ParseScalar(type);
       break;
   }
+  return val;
 }
 
-void Parser::SerializeStruct(const StructDef &struct_def, const Value &val) {
-  auto off = atot<uoffset_t>(val.constant.c_str());
+// Moves a struct from struct_stack_ (where "val" says it starts) into the
+// builder.
+void Parser::SerializeStruct(const StructDef &struct_def, ScalarValue val) {
+  auto off = static_cast<size_t>(val.i);
   assert(struct_stack_.size() - off == struct_def.bytesize);
   builder_.Align(struct_def.minalign);
   builder_.PushBytes(&struct_stack_[off], struct_def.bytesize);
   struct_stack_.resize(struct_stack_.size() - struct_def.bytesize);
-  builder_.AddStructOffset(val.offset, builder_.GetSize());
 }
 
 uoffset_t Parser::ParseTable(const StructDef &struct_def) {
@@ -545,33 +666,29 @@ uoffset_t Parser::ParseTable(const StructDef &struct_def) {
   size_t fieldn = 0;
   for (;;) {
     if ((!strict_json_ || !fieldn) && IsNext('}')) break;
-    std::string name = attribute_;
-    if (!IsNext(kTokenStringConstant))
+    if (token_ != kTokenStringConstant &&
+        (strict_json_ || token_ != kTokenIdentifier))
       Expect(strict_json_ ? kTokenStringConstant : kTokenIdentifier);
-    auto field = struct_def.fields.Lookup(name);
-    if (!field) Error("unknown field: " + name);
+    // Look the name up straight from the token, before moving past it.
+    auto field = struct_def.fields.Lookup(attribute_);
+    if (!field) Error("unknown field: " + attribute_);
+    Next();
+    for (auto it = field_stack_.end() - fieldn; it != field_stack_.end();
+         ++it) {
+      if (it->second == field)
+        Error("field set more than once: " + field->name);
+    }
     if (struct_def.fixed && (fieldn >= struct_def.fields.vec.size()
                             || struct_def.fields.vec[fieldn] != field)) {
-       Error("struct field appearing out of order: " + name);
+       Error("struct field appearing out of order: " + field->name);
     }
     Expect(':');
-    Value val = field->value;
-    ParseAnyValue(val, field);
-    field_stack_.push_back(std::make_pair(val, field));
+    field_stack_.push_back(std::make_pair(
+                             ParseAnyValue(field->value.type, field), field));
     fieldn++;
     if (IsNext('}')) break;
     Expect(',');
   }
-  for (auto it = field_stack_.rbegin();
-           it != field_stack_.rbegin() + fieldn; ++it) {
-    if (it->second->used)
-      Error("field set more than once: " + it->second->name);
-    it->second->used = true;
-  }
-  for (auto it = field_stack_.rbegin();
-           it != field_stack_.rbegin() + fieldn; ++it) {
-    it->second->used = false;
-  }
   if (struct_def.fixed && fieldn != struct_def.fields.vec.size())
     Error("incomplete struct initialization: " + struct_def.name);
   auto start = struct_def.fixed
@@ -584,19 +701,20 @@ uoffset_t Parser::ParseTable(const StructDef &struct_def) {
     // Go through elements in reverse, since we're building the data backwards.
     for (auto it = field_stack_.rbegin();
              it != field_stack_.rbegin() + fieldn; ++it) {
-      auto &value = it->first;
+      auto value = it->first;
       auto field = it->second;
-      if (!struct_def.sortbysize || size == SizeOf(value.type.base_type)) {
-        switch (value.type.base_type) {
+      auto base_type = field->value.type.base_type;
+      if (!struct_def.sortbysize || size == SizeOf(base_type)) {
+        switch (base_type) {
           #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, \
             PTYPE) \
             case BASE_TYPE_ ## ENUM: \
               builder_.Pad(field->padding); \
               if (struct_def.fixed) { \
-                builder_.PushElement(atot<CTYPE>(value.constant.c_str())); \
+                builder_.PushElement(ValueAs<CTYPE>(value)); \
               } else { \
-                builder_.AddElement(value.offset, \
-                             atot<CTYPE>(       value.constant.c_str()), \
+                builder_.AddElement(field->value.offset, \
+                             ValueAs<CTYPE>(value), \
                              atot<CTYPE>(field->value.constant.c_str())); \
               } \
               break;
@@ -608,9 +726,11 @@ uoffset_t Parser::ParseTable(const StructDef &struct_def) {
               builder_.Pad(field->padding); \
               if (IsStruct(field->value.type)) { \
                 SerializeStruct(*field->value.type.struct_def, value); \
+                builder_.AddStructOffset(field->value.offset, \
+                                         builder_.GetSize()); \
               } else { \
-                builder_.AddOffset(value.offset, \
-                  atot<CTYPE>(value.constant.c_str())); \
+                builder_.AddOffset(field->value.offset, \
+                                   ValueAs<CTYPE>(value)); \
               } \
               break;
             FLATBUFFERS_GEN_TYPES_POINTER(FLATBUFFERS_TD);
@@ -643,10 +763,8 @@ uoffset_t Parser::ParseVector(const Type &type) {
   int count = 0;
   for (;;) {
     if ((!strict_json_ || !count) && IsNext(']')) break;
-    Value val;
-    val.type = type;
-    ParseAnyValue(val, nullptr);
-    field_stack_.push_back(std::make_pair(val, nullptr));
+    field_stack_.push_back(std::make_pair(ParseAnyValue(type, nullptr),
+                                          nullptr));
     count++;
     if (IsNext(']')) break;
     Expect(',');
@@ -656,12 +774,12 @@ uoffset_t Parser::ParseVector(const Type &type) {
                        InlineAlignment(type));
   for (int i = 0; i < count; i++) {
     // start at the back, since we're building the data backwards.
-    auto &val = field_stack_.back().first;
-    switch (val.type.base_type) {
+    auto val = field_stack_.back().first;
+    switch (type.base_type) {
       #define FLATBUFFERS_TD(ENUM, IDLTYPE, CTYPE, JTYPE, GTYPE, NTYPE, PTYPE) \
         case BASE_TYPE_ ## ENUM: \
-          if (IsStruct(val.type)) SerializeStruct(*val.type.struct_def, val); \
-          else builder_.PushElement(atot<CTYPE>(val.constant.c_str())); \
+          if (IsStruct(type)) SerializeStruct(*type.struct_def, val); \
+          else builder_.PushElement(ValueAs<CTYPE>(val)); \
           break;
         FLATBUFFERS_GEN_TYPES(FLATBUFFERS_TD)
       #undef FLATBUFFERS_TD
@@ -673,6 +791,21 @@ uoffset_t Parser::ParseVector(const Type &type) {
   return builder_.EndVector(count);
 }
 
+// A vector of bytes given as a base64 string, decoded straight into the
+// builder.
+uoffset_t Parser::ParseBase64Vector() {
+  auto len = attribute_.length();
+  size_t size;
+  if (!Base64DecodedSize(attribute_.c_str(), &len, &size))
+    Error("base64 string of invalid length");
+  uint8_t *buf;
+  auto off = builder_.CreateUninitializedVector(size, 1, &buf);
+  if (!Base64Decode(attribute_.c_str(), len, buf))
+    Error("invalid base64 string");
+  Expect(kTokenStringConstant);
+  return off;
+}
+
 void Parser::ParseMetaData(Definition &def) {
   if (IsNext('(')) {
     for (;;) {
@@ -680,7 +813,7 @@ void Parser::ParseMetaData(Definition &def) {
       Expect(kTokenIdentifier);
       if (known_attributes_.find(name) == known_attributes_.end())
         Error("user define attributes must be declared before use: " + name);
-      auto e = new Value();
+      auto e = arena_.New<Value>();
       def.attributes.Add(name, e);
       if (IsNext(':')) {
         ParseSingleValue(*e);
@@ -713,7 +846,7 @@ bool Parser::TryTypedValue(int dtoken,
   return match;
 }
 
-int64_t Parser::ParseIntegerFromString(Type &type) {
+int64_t Parser::ParseIntegerFromString(const Type &type) {
   int64_t result = 0;
   // Parse one or more enum identifiers, separated by spaces.
   const char *next = attribute_.c_str();
@@ -752,28 +885,28 @@ int64_t Parser::ParseIntegerFromString(Type &type) {
 }
 
 
-void Parser::ParseHash(Value &e, FieldDef* field) {
+int64_t Parser::ParseHash(const Type &type, FieldDef *field) {
   assert(field);
   Value *hash_name = field->attributes.Lookup("hash");
-  switch (e.type.base_type) {
+  int64_t hashed_value = 0;
+  switch (type.base_type) {
     case BASE_TYPE_INT:
     case BASE_TYPE_UINT: {
       auto hash = FindHashFunction32(hash_name->constant.c_str());
-      uint32_t hashed_value = hash(attribute_.c_str());
-      e.constant = NumToString(hashed_value);
+      hashed_value = hash(attribute_.c_str());
       break;
     }
     case BASE_TYPE_LONG:
     case BASE_TYPE_ULONG: {
       auto hash = FindHashFunction64(hash_name->constant.c_str());
-      uint64_t hashed_value = hash(attribute_.c_str());
-      e.constant = NumToString(hashed_value);
+      hashed_value = static_cast<int64_t>(hash(attribute_.c_str()));
       break;
     }
     default:
       assert(0);
   }
   Next();
+  return hashed_value;
 }
 
 void Parser::ParseSingleValue(Value &e) {
@@ -800,6 +933,40 @@ void Parser::ParseSingleValue(Value &e) {
   }
 }
 
+// Floats are parsed as such rather than as doubles, so they are rounded
+// only once.
+double Parser::ParseFloat(const Type &type) {
+  return type.base_type == BASE_TYPE_FLOAT
+    ? StringToFloat<float>(attribute_.c_str())
+    : StringToFloat<double>(attribute_.c_str());
+}
+
+// Like ParseSingleValue, but for values in JSON data: converts the token
+// straight to the binary form of "type".
+ScalarValue Parser::ParseScalar(const Type &type) {
+  ScalarValue val;
+  if (token_ == kTokenIdentifier || token_ == kTokenStringConstant) {
+    val.i = ParseIntegerFromString(type);
+    if (IsFloat(type.base_type)) val.f = static_cast<double>(val.i);
+  } else if (token_ == kTokenIntegerConstant) {
+    if (IsFloat(type.base_type)) val.f = ParseFloat(type);
+    else val.i = StringToInt(attribute_.c_str());
+  } else if (token_ == kTokenFloatConstant) {
+    if (!IsFloat(type.base_type))
+      Error(std::string("type mismatch: expecting: ") +
+            kTypeNames[type.base_type] +
+            ", found: " +
+            kTypeNames[BASE_TYPE_FLOAT]);
+    val.f = ParseFloat(type);
+  } else {
+    Error("cannot parse value starting with: " + TokenToString(token_));
+  }
+  if (IsInteger(type.base_type) && type.base_type != BASE_TYPE_BOOL)
+    CheckBitsFit(val.i, SizeOf(type.base_type) * 8);
+  Next();
+  return val;
+}
+
 StructDef *Parser::LookupCreateStruct(const std::string &name) {
   std::string qualified_name = GetFullyQualifiedName(name);
   auto struct_def = structs_.Lookup(qualified_name);
@@ -808,7 +975,7 @@ StructDef *Parser::LookupCreateStruct(const std::string &name) {
   if (!struct_def) {
     // Rather than failing, we create a "pre declared" StructDef, due to
     // circular references, and check for errors at the end of parsing.
-    struct_def = new StructDef();
+    struct_def = arena_.New<StructDef>();
     structs_.Add(qualified_name, struct_def);
     struct_def->name = name;
     struct_def->predecl = true;
@@ -822,7 +989,7 @@ void Parser::ParseEnum(bool is_union) {
   Next();
   std::string enum_name = attribute_;
   Expect(kTokenIdentifier);
-  auto &enum_def = *new EnumDef();
+  auto &enum_def = *arena_.New<EnumDef>();
   enum_def.name = enum_name;
   if (!files_being_parsed_.empty()) enum_def.file = files_being_parsed_.top();
   enum_def.doc_comment = enum_comment;
@@ -851,7 +1018,7 @@ void Parser::ParseEnum(bool is_union) {
   }
   ParseMetaData(enum_def);
   Expect('{');
-  if (is_union) enum_def.vals.Add("NONE", new EnumVal("NONE", 0));
+  if (is_union) enum_def.vals.Add("NONE", arena_.New<EnumVal>("NONE", 0));
   do {
     auto value_name = attribute_;
     auto full_name = value_name;
@@ -862,7 +1029,7 @@ void Parser::ParseEnum(bool is_union) {
     auto value = enum_def.vals.vec.size()
       ? enum_def.vals.vec.back()->value + 1
       : 0;
-    auto &ev = *new EnumVal(value_name, value);
+    auto &ev = *arena_.New<EnumVal>(value_name, value);
     if (enum_def.vals.Add(value_name, &ev))
       Error("enum value already exists: " + value_name);
     ev.doc_comment = value_comment;
@@ -898,7 +1065,9 @@ StructDef &Parser::StartStruct() {
   if (!files_being_parsed_.empty()) struct_def.file = files_being_parsed_.top();
   // Move this struct to the back of the vector just in case it was predeclared,
   // to preserve declaration order.
-  *remove(structs_.vec.begin(), structs_.vec.end(), &struct_def) = &struct_def;
+  if (structs_.vec.back() != &struct_def)
+    *remove(structs_.vec.begin(), structs_.vec.end(), &struct_def) =
+      &struct_def;
   return struct_def;
 }
 
@@ -986,7 +1155,7 @@ void Parser::ParseDecl() {
 }
 
 bool Parser::SetRootType(const char *name) {
-  root_struct_def_ = structs_.Lookup(GetFullyQualifiedName(name));
+  root_struct_def_ = schema_->structs_.Lookup(GetFullyQualifiedName(name));
   return root_struct_def_ != nullptr;
 }
 
@@ -1148,8 +1317,16 @@ Type Parser::ParseTypeFromProtoType() {
 
 bool Parser::Parse(const char *source, const char **include_paths,
                    const char *source_filename) {
-  if (source_filename &&
-      included_files_.find(source_filename) == included_files_.end()) {
+  return Parse(source, strlen(source), include_paths, source_filename);
+}
+
+bool Parser::Parse(const char *source, size_t length,
+                   const char **include_paths, const char *source_filename) {
+  // Only files not parsed before count as being parsed (e.g. a file passed
+  // to flatc after another one included it doesn't).
+  bool new_file = source_filename &&
+      included_files_.find(source_filename) == included_files_.end();
+  if (new_file) {
     included_files_[source_filename] = true;
     files_included_per_file_[source_filename] = std::set<std::string>();
     files_being_parsed_.push(source_filename);
@@ -1159,6 +1336,7 @@ bool Parser::Parse(const char *source, const char **include_paths,
     include_paths = current_directory;
   }
   source_ = cursor_ = source;
+  end_ = source + length;
   line_ = 1;
   error_.clear();
   builder_.Clear();
@@ -1166,6 +1344,7 @@ bool Parser::Parse(const char *source, const char **include_paths,
     Next();
     // Includes must come first:
     while (IsNext(kTokenInclude)) {
+      if (schema_ != this) Error("a parser sharing a schema can't include");
       auto name = attribute_;
       Expect(kTokenStringConstant);
       // Look for the file in include_paths.
@@ -1184,20 +1363,26 @@ bool Parser::Parse(const char *source, const char **include_paths,
         std::string contents;
         if (!LoadFile(filepath.c_str(), true, &contents))
           Error("unable to load include file: " + name);
-        if (!Parse(contents.c_str(), include_paths, filepath.c_str())) {
+        // Parsing it replaces our tokenizer state, so save that to carry on
+        // with this file from right after the include afterwards.
+        auto saved_source = source_, saved_cursor = cursor_,
+             saved_end = end_;
+        auto saved_line = line_, saved_token = token_;
+        auto saved_attribute = attribute_;
+        if (!Parse(contents.c_str(), contents.length(), include_paths,
+                   filepath.c_str())) {
           // Any errors, we're done.
+          if (new_file) files_being_parsed_.pop();
           return false;
         }
         // We do not want to output code for any included files:
         MarkGenerated();
-        // This is the easiest way to continue this file after an include:
-        // instead of saving and restoring all the state, we simply start the
-        // file anew. This will cause it to encounter the same include statement
-        // again, but this time it will skip it, because it was entered into
-        // included_files_.
-        // This is recursive, but only go as deep as the number of include
-        // statements.
-        return Parse(source, include_paths, source_filename);
+        source_ = saved_source;
+        cursor_ = saved_cursor;
+        end_ = saved_end;
+        line_ = saved_line;
+        token_ = saved_token;
+        attribute_ = saved_attribute;
       }
       Expect(';');
     }
@@ -1205,6 +1390,8 @@ bool Parser::Parse(const char *source, const char **include_paths,
     namespaces_.push_back(new Namespace());
     // Now parse all other kinds of declarations:
     while (token_ != kTokenEof) {
+      if (schema_ != this && token_ != '{')
+        Error("a parser sharing a schema can only parse json");
       if (proto_mode_) {
         ParseProtoDecl();
       } else if (token_ == kTokenNameSpace) {
@@ -1272,23 +1459,88 @@ bool Parser::Parse(const char *source, const char **include_paths,
         }
       }
     }
+    BuildLookupIndices();
   } catch (const std::string &msg) {
-    error_ = source_filename ? AbsolutePath(source_filename) : "";
-    #ifdef _WIN32
-      error_ += "(" + NumToString(line_) + ")";  // MSVC alike
-    #else
-      if (source_filename) error_ += ":";
-      error_ += NumToString(line_) + ":0";  // gcc alike
-    #endif
-    error_ += ": error: " + msg;
-    if (source_filename) files_being_parsed_.pop();
+    SetError(msg, source_filename);
+    if (new_file) files_being_parsed_.pop();
     return false;
   }
-  if (source_filename) files_being_parsed_.pop();
+  if (new_file) files_being_parsed_.pop();
   assert(!struct_stack_.size());
   return true;
 }
 
+// Done once definitions are complete, so JSON parsing (possibly by many
+// threads, see Parser(const Parser *)) only ever reads them.
+void Parser::BuildLookupIndices() {
+  if (!structs_.HasIndex()) structs_.BuildIndex();
+  if (!enums_.HasIndex()) enums_.BuildIndex();
+  for (auto it = structs_.vec.begin(); it != structs_.vec.end(); ++it) {
+    if (!(*it)->fields.HasIndex()) (*it)->fields.BuildIndex();
+  }
+  for (auto it = enums_.vec.begin(); it != enums_.vec.end(); ++it) {
+    if (!(*it)->vals.HasIndex()) (*it)->vals.BuildIndex();
+    if (!(*it)->HasReverseIndex()) (*it)->BuildReverseIndex();
+  }
+}
+
+void Parser::SetError(const std::string &msg, const char *source_filename) {
+  error_ = source_filename ? AbsolutePath(source_filename) : "";
+  #ifdef _WIN32
+    error_ += "(" + NumToString(line_) + ")";  // MSVC alike
+  #else
+    if (source_filename) error_ += ":";
+    error_ += NumToString(line_) + ":0";  // gcc alike
+  #endif
+  error_ += ": error: " + msg;
+}
+
+void Parser::StartJsonStream(const char *source,
+                             const char *source_filename,
+                             int line) {
+  StartJsonStream(source, strlen(source), source_filename, line);
+}
+
+void Parser::StartJsonStream(const char *source, size_t length,
+                             const char *source_filename,
+                             int line) {
+  source_ = cursor_ = source;
+  end_ = source + length;
+  stream_filename_ = source_filename;
+  line_ = line;
+  token_ = kTokenEof;
+  error_.clear();
+  builder_.Clear();
+  try {
+    Next();
+  } catch (const std::string &msg) {
+    SetError(msg, stream_filename_);
+    // Stop at the error.
+    cursor_ = end_;
+    token_ = kTokenEof;
+  }
+}
+
+bool Parser::ParseNextJson() {
+  builder_.Clear();
+  if (token_ == kTokenEof) return false;
+  try {
+    if (!root_struct_def_) Error("no root type set to parse json with");
+    builder_.Finish(Offset<Table>(ParseTable(*root_struct_def_)),
+      file_identifier_.length() ? file_identifier_.c_str() : nullptr);
+  } catch (const std::string &msg) {
+    SetError(msg, stream_filename_);
+    // Leave the parser usable for another stream.
+    builder_.Clear();
+    field_stack_.clear();
+    struct_stack_.clear();
+    cursor_ = end_;
+    token_ = kTokenEof;
+    return false;
+  }
+  return true;
+}
+
 std::set<std::string> Parser::GetIncludedFilesRecursive(
     const std::string &file_name) const {
   std::set<std::string> included_files;
@@ -1378,7 +1630,8 @@ Offset<reflection::Field> FieldDef::Serialize(FlatBufferBuilder *builder,
                                    ? StringToInt(value.constant.c_str())
                                    : 0,
                                  IsFloat(value.type.base_type)
-                                   ? strtod(value.constant.c_str(), nullptr)
+                                   ? StringToFloat<double>(
+                                       value.constant.c_str())
                                    : 0.0,
                                  deprecated,
                                  required,
@@ -1417,4 +1670,144 @@ Offset<reflection::Type> Type::Serialize(FlatBufferBuilder *builder) const {
                                              (enum_def ? enum_def->index : -1));
 }
 
+// Schema deserialization functionality:
+
+bool Parser::Deserialize(const reflection::Schema &schema) {
+  try {
+    auto objects = schema.objects();
+    auto enums = schema.enums();
+    // Create all definitions first, since types refer to them by index.
+    std::vector<StructDef *> struct_defs;
+    for (auto it = objects->begin(); it != objects->end(); ++it) {
+      auto struct_def = arena_.New<StructDef>();
+      struct_def->name = it->name()->str();
+      struct_def->defined_namespace = namespaces_.back();
+      struct_def->predecl = false;
+      struct_def->fixed = it->is_struct();
+      struct_def->sortbysize = !struct_def->fixed;
+      struct_def->minalign = it->minalign();
+      struct_def->bytesize = it->bytesize();
+      if (structs_.Add(struct_def->name, struct_def))
+        Error("datatype already exists: " + struct_def->name);
+      struct_defs.push_back(struct_def);
+    }
+    std::vector<EnumDef *> enum_defs;
+    for (auto it = enums->begin(); it != enums->end(); ++it) {
+      auto enum_def = arena_.New<EnumDef>();
+      enum_def->name = it->name()->str();
+      enum_def->defined_namespace = namespaces_.back();
+      if (enums_.Add(enum_def->name, enum_def))
+        Error("enum already exists: " + enum_def->name);
+      enum_defs.push_back(enum_def);
+    }
+
+    auto deserialize_type = [&](const reflection::Type &rtype) {
+      Type type(static_cast<BaseType>(rtype.base_type()));
+      type.element = static_cast<BaseType>(rtype.element());
+      if (type.base_type > BASE_TYPE_UNION ||
+          type.element > BASE_TYPE_UNION)
+        Error("unknown type in binary schema");
+      auto index = rtype.index();
+      auto inner = type.base_type == BASE_TYPE_VECTOR ? type.element
+                                                      : type.base_type;
+      if (index < 0) {
+        // These can't do without the definition they refer to.
+        if (inner == BASE_TYPE_STRUCT || inner == BASE_TYPE_UNION ||
+            inner == BASE_TYPE_UTYPE)
+          Error("missing type index in binary schema");
+        return type;
+      }
+      if (inner == BASE_TYPE_STRUCT) {
+        if (index >= static_cast<int>(struct_defs.size()))
+          Error("type index out of range in binary schema");
+        type.struct_def = struct_defs[index];
+      } else {
+        if (index >= static_cast<int>(enum_defs.size()))
+          Error("type index out of range in binary schema");
+        type.enum_def = enum_defs[index];
+      }
+      return type;
+    };
+
+    for (uoffset_t i = 0; i < objects->size(); i++) {
+      auto object = objects->Get(i);
+      auto &struct_def = *struct_defs[i];
+      // Fields are stored sorted by name, restore declaration order.
+      std::vector<const reflection::Field *> fields(object->fields()->begin(),
+                                                    object->fields()->end());
+      std::sort(fields.begin(), fields.end(),
+                [](const reflection::Field *a, const reflection::Field *b) {
+        return a->id() < b->id();
+      });
+      for (auto it = fields.begin(); it != fields.end(); ++it) {
+        auto field = *it;
+        auto &field_def = *arena_.New<FieldDef>();
+        field_def.name = field->name()->str();
+        field_def.defined_namespace = struct_def.defined_namespace;
+        field_def.value.type = deserialize_type(*field->type());
+        field_def.value.offset = field->offset();
+        auto base_type = field_def.value.type.base_type;
+        if (struct_def.fixed && !IsScalar(base_type) &&
+            !IsStruct(field_def.value.type))
+          Error("structs may contain only scalar or struct fields: " +
+                struct_def.name + "." + field_def.name);
+        if (IsInteger(base_type))
+          field_def.value.constant = NumToString(field->default_integer());
+        else if (IsFloat(base_type))
+          field_def.value.constant = NumToString(field->default_real());
+        field_def.deprecated = field->deprecated();
+        field_def.required = field->required();
+        field_def.key = field->key();
+        if (field_def.key) struct_def.has_key = true;
+        if (struct_def.fields.Add(field_def.name, &field_def))
+          Error("field already exists: " + field_def.name);
+      }
+      if (struct_def.fixed) {
+        // Padding follows from the gaps between field offsets.
+        auto &vec = struct_def.fields.vec;
+        for (size_t j = 0; j < vec.size(); j++) {
+          auto end = vec[j]->value.offset + InlineSize(vec[j]->value.type);
+          auto next = j + 1 < vec.size() ? vec[j + 1]->value.offset
+                                         : struct_def.bytesize;
+          if (next < end) Error("overlapping fields in struct: " +
+                                struct_def.name);
+          vec[j]->padding = next - end;
+        }
+      }
+    }
+
+    for (uoffset_t i = 0; i < enums->size(); i++) {
+      auto rdef = enums->Get(i);
+      auto &enum_def = *enum_defs[i];
+      enum_def.is_union = rdef->is_union();
+      enum_def.underlying_type = deserialize_type(*rdef->underlying_type());
+      for (auto it = rdef->values()->begin(); it != rdef->values()->end();
+           ++it) {
+        auto &ev = *arena_.New<EnumVal>(it->name()->str(),
+                                              it->value());
+        if (enum_def.vals.Add(ev.name, &ev))
+          Error("enum value already exists: " + ev.name);
+        if (it->object()) {
+          auto struct_def = structs_.Lookup(it->object()->name()->str());
+          if (!struct_def) Error("unknown union member: " + ev.name);
+          if (struct_def->fixed)
+            Error("union members must be tables: " + ev.name);
+          ev.struct_def = struct_def;
+        }
+      }
+    }
+
+    if (schema.root_table()) {
+      root_struct_def_ = structs_.Lookup(schema.root_table()->name()->str());
+    }
+    if (schema.file_ident()) file_identifier_ = schema.file_ident()->str();
+    if (schema.file_ext()) file_extension_ = schema.file_ext()->str();
+    BuildLookupIndices();
+  } catch (const std::string &msg) {
+    error_ = "error: " + msg;
+    return false;
+  }
+  return true;
+}
+
 }  // namespace flatbuffers
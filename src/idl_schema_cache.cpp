@@ -0,0 +1,158 @@
+/*
+ * Copyright 2015 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Process-wide cache of parsed schemas.
+
+#include "flatbuffers/flatbuffers.h"
+#include "flatbuffers/idl.h"
+#include "flatbuffers/util.h"
+
+namespace flatbuffers {
+
+// FNV-1a over all of "contents", which may hold 0 bytes (binary schemas).
+static uint64_t HashContents(const std::string &contents) {
+  uint64_t hash = FnvTraits<uint64_t>::kOffsetBasis;
+  for (auto it = contents.begin(); it != contents.end(); ++it) {
+    hash ^= static_cast<unsigned char>(*it);
+    hash *= FnvTraits<uint64_t>::kFnvPrime;
+  }
+  return hash;
+}
+
+// Whether any of "file_hashes" changed, or can't be read anymore.
+static bool FilesChanged(const std::map<std::string, uint64_t> &file_hashes) {
+  for (auto file = file_hashes.begin(); file != file_hashes.end(); ++file) {
+    std::string contents;
+    if (!LoadFile(file->first.c_str(), true, &contents) ||
+        HashContents(contents) != file->second)
+      return true;
+  }
+  return false;
+}
+
+// Parses (or deserializes, if binary) the schema in "filename", and hashes
+// all files it was parsed from.
+static bool LoadSchema(const std::string &filename, const char **include_paths,
+                       std::shared_ptr<const Parser> *parser_out,
+                       std::map<std::string, uint64_t> *file_hashes,
+                       std::string *error) {
+  std::string contents;
+  if (!LoadFile(filename.c_str(), true, &contents)) {
+    *error = "unable to load file: " + filename;
+    return false;
+  }
+  auto parser = std::make_shared<Parser>();
+  if (StripExtension(filename) + "." + reflection::SchemaExtension() ==
+      filename) {
+    Verifier verifier(reinterpret_cast<const uint8_t *>(contents.c_str()),
+                      contents.length());
+    if (!reflection::VerifySchemaBuffer(verifier)) {
+      *error = "not a valid binary schema: " + filename;
+      return false;
+    }
+    if (!parser->Deserialize(*reflection::GetSchema(contents.c_str()))) {
+      *error = filename + ": " + parser->error_;
+      return false;
+    }
+    (*file_hashes)[AbsolutePath(filename)] = HashContents(contents);
+  } else {
+    if (!parser->Parse(contents.c_str(), contents.length(), include_paths,
+                       filename.c_str())) {
+      *error = parser->error_;
+      return false;
+    }
+    auto files = parser->GetIncludedFilesRecursive(filename);
+    for (auto file = files.begin(); file != files.end(); ++file) {
+      // Included files were read just now, so failing here means they
+      // changed under us, which is caught by the next Get().
+      std::string file_contents;
+      (*file_hashes)[AbsolutePath(*file)] =
+        *file == filename ? HashContents(contents)
+                          : (LoadFile(file->c_str(), true, &file_contents)
+                               ? HashContents(file_contents) : 0);
+    }
+  }
+  *parser_out = parser;
+  return true;
+}
+
+std::shared_ptr<const Parser> SchemaCache::Get(const std::string &filename,
+                                               const char **include_paths,
+                                               std::string *error) {
+  // The same file may resolve its includes differently given other paths.
+  auto key = AbsolutePath(filename);
+  for (auto paths = include_paths; paths && *paths; paths++) {
+    key += '\0';
+    key += *paths;
+  }
+
+  // Files are read, hashed and parsed without holding the lock, so that
+  // other schemas can be got meanwhile. Entries being loaded are marked as
+  // such, and waited for, so each schema is only parsed once.
+  std::shared_ptr<Entry> entry;
+  for (;;) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      entry = std::make_shared<Entry>();
+      entries_[key] = entry;
+      break;
+    }
+    auto cached = it->second;
+    loaded_.wait(lock, [&]() { return !cached->loading; });
+    // Failed to load, so it's gone, and up to us to try again.
+    if (!cached->parser) continue;
+    lock.unlock();
+    // Loaded entries don't change anymore, so can be read without the lock.
+    if (!FilesChanged(cached->file_hashes)) return cached->parser;
+    lock.lock();
+    // Reload it, unless someone else beat us to it.
+    it = entries_.find(key);
+    if (it != entries_.end() && it->second == cached) {
+      entry = std::make_shared<Entry>();
+      it->second = entry;
+      break;
+    }
+  }
+
+  std::shared_ptr<const Parser> parser;
+  std::map<std::string, uint64_t> file_hashes;
+  auto ok = LoadSchema(filename, include_paths, &parser, &file_hashes, error);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry->parser = parser;
+    entry->file_hashes.swap(file_hashes);
+    entry->loading = false;
+    if (!ok) {
+      auto it = entries_.find(key);
+      if (it != entries_.end() && it->second == entry) entries_.erase(it);
+    }
+  }
+  loaded_.notify_all();
+  return ok ? parser : nullptr;
+}
+
+void SchemaCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+SchemaCache &SchemaCache::Global() {
+  static SchemaCache cache;
+  return cache;
+}
+
+}  // namespace flatbuffers
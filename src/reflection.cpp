@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <map>
+
 #include "flatbuffers/reflection.h"
 #include "flatbuffers/util.h"
 
@@ -53,7 +56,7 @@ double GetAnyValueF(reflection::BaseType type, const uint8_t *data) {
     case reflection::String: {
       auto s = reinterpret_cast<const String *>(ReadScalar<uoffset_t>(data) +
                                                 data);
-      return s ? strtod(s->c_str(), nullptr) : 0.0;
+      return s ? StringToFloat<double>(s->c_str()) : 0.0;
     }
     default: return static_cast<double>(GetAnyValueI(type, data));
   }
@@ -62,8 +65,8 @@ double GetAnyValueF(reflection::BaseType type, const uint8_t *data) {
 std::string GetAnyValueS(reflection::BaseType type, const uint8_t *data,
                          const reflection::Schema *schema, int type_index) {
   switch (type) {
-    case reflection::Float:
-    case reflection::Double: return NumToString(GetAnyValueF(type, data));
+    case reflection::Float:  return NumToString(ReadScalar<float>(data));
+    case reflection::Double: return NumToString(ReadScalar<double>(data));
     case reflection::String: {
       auto s = reinterpret_cast<const String *>(ReadScalar<uoffset_t>(data) +
                                                 data);
@@ -142,7 +145,7 @@ void SetAnyValueS(reflection::BaseType type, uint8_t *data, const char *val) {
   switch (type) {
     case reflection::Float:
     case reflection::Double:
-      SetAnyValueF(type, data, strtod(val, nullptr));
+      SetAnyValueF(type, data, StringToFloat<double>(val));
       break;
     // TODO: support strings.
     default: SetAnyValueI(type, data, StringToInt(val)); break;
@@ -298,6 +301,8 @@ void SetString(const reflection::Schema &schema, const std::string &val,
   }
   // Copy new data. Safe because we created the right amount of space.
   memcpy(flatbuf->data() + start, val.c_str(), val.size() + 1);
+  WriteScalar(flatbuf->data() + start - sizeof(uoffset_t),
+              static_cast<uoffset_t>(val.size()));
 }
 
 uint8_t *ResizeAnyVector(const reflection::Schema &schema, uoffset_t newsize,
@@ -341,6 +346,318 @@ const uint8_t *AddFlatBuffer(std::vector<uint8_t> &flatbuf,
   return flatbuf.data() + insertion_point + root_offset;
 }
 
+// Removes unreachable data from a FlatBuffer. First marks the byte ranges of
+// all objects (tables, vtables, strings, vectors) reachable from the root, and
+// remembers the location of every offset that refers to one of them. Then
+// slides the marked ranges together into a new buffer, and rewrites each offset
+// to its new distance.
+// Ranges are only ever moved by a multiple of the largest alignment in the
+// schema, such that all data inside them stays correctly aligned. Vtables are
+// moved along with everything else, but otherwise left untouched.
+class CompactContext {
+ public:
+  CompactContext(const reflection::Schema &schema,
+                 std::vector<uint8_t> *flatbuf)
+     : schema_(schema), buf_(*flatbuf),
+       visited_(flatbuf->size() / sizeof(uoffset_t), false),
+       align_(sizeof(largest_scalar_t)) {
+    auto objects = schema.objects();
+    for (auto it = objects->begin(); it != objects->end(); ++it) {
+      if ((*it)->is_struct())
+        align_ = std::max(align_, static_cast<size_t>((*it)->minalign()));
+    }
+  }
+
+  size_t Compact(const reflection::Object &root_table) {
+    // The root offset and the (optional) file identifier.
+    Mark(buf_.data(),
+         sizeof(uoffset_t) + FlatBufferBuilder::kFileIdentifierLength);
+    offsets_.push_back(0);
+    MarkTable(root_table, GetAnyRoot(buf_.data()));
+    auto oldsize = buf_.size();
+    Relocate();
+    return oldsize - buf_.size();
+  }
+
+  void operator=(const CompactContext &cc);
+
+ private:
+  struct Range {
+    uoffset_t start, end, delta;
+    bool operator<(const Range &other) const { return start < other.start; }
+  };
+
+  uoffset_t Loc(const void *p) const {
+    return static_cast<uoffset_t>(reinterpret_cast<const uint8_t *>(p) -
+                                  buf_.data());
+  }
+
+  void Mark(const void *p, size_t size) {
+    Range r = { Loc(p), static_cast<uoffset_t>(Loc(p) + size), 0 };
+    ranges_.push_back(r);
+  }
+
+  // Returns true the first time an object at a given location is seen.
+  bool Visit(const void *p) {
+    auto &visited = visited_[Loc(p) / sizeof(uoffset_t)];
+    if (visited) return false;
+    visited = true;
+    return true;
+  }
+
+  // Remembers an offset to be rewritten, and returns what it points to.
+  uint8_t *Follow(uint8_t *offsetloc) {
+    offsets_.push_back(Loc(offsetloc));
+    return offsetloc + ReadScalar<uoffset_t>(offsetloc);
+  }
+
+  void MarkTable(const reflection::Object &objectdef, Table *table) {
+    if (!Visit(table)) return;
+    auto vtable = table->GetVTable();
+    Mark(vtable, ReadScalar<voffset_t>(vtable));
+    Mark(table, ReadScalar<voffset_t>(vtable + sizeof(voffset_t)));
+    tables_.push_back(Loc(table));
+    auto tableloc = reinterpret_cast<uint8_t *>(table);
+    auto fielddefs = objectdef.fields();
+    for (auto it = fielddefs->begin(); it != fielddefs->end(); ++it) {
+      auto &fielddef = **it;
+      auto base_type = fielddef.type()->base_type();
+      // Scalars and structs are stored inline, and already marked.
+      if (base_type <= reflection::Double) continue;
+      auto offset = table->GetOptionalFieldOffset(fielddef.offset());
+      if (!offset) continue;
+      auto subobjectdef = base_type == reflection::Obj ?
+        schema_.objects()->Get(fielddef.type()->index()) : nullptr;
+      if (subobjectdef && subobjectdef->is_struct()) continue;
+      auto ref = Follow(tableloc + offset);
+      switch (base_type) {
+        case reflection::Obj:
+          MarkTable(*subobjectdef, reinterpret_cast<Table *>(ref));
+          break;
+        case reflection::Union:
+          MarkTable(GetUnionType(schema_, objectdef, fielddef, *table),
+                    reinterpret_cast<Table *>(ref));
+          break;
+        case reflection::String:
+          if (Visit(ref))
+            Mark(ref, sizeof(uoffset_t) +
+                      reinterpret_cast<String *>(ref)->Length() + 1);
+          break;
+        case reflection::Vector:
+          MarkVector(fielddef, reinterpret_cast<VectorOfAny *>(ref));
+          break;
+        default:
+          assert(false);
+      }
+    }
+  }
+
+  void MarkVector(const reflection::Field &fielddef, VectorOfAny *vec) {
+    if (!Visit(vec)) return;
+    auto elem_type = fielddef.type()->element();
+    auto elem_size = GetTypeSizeInline(elem_type, fielddef.type()->index(),
+                                       schema_);
+    Mark(vec, sizeof(uoffset_t) + elem_size * vec->size());
+    if (elem_type != reflection::Obj && elem_type != reflection::String)
+      return;
+    auto elemobjectdef = elem_type == reflection::Obj
+      ? schema_.objects()->Get(fielddef.type()->index())
+      : nullptr;
+    if (elemobjectdef && elemobjectdef->is_struct()) return;
+    for (uoffset_t i = 0; i < vec->size(); i++) {
+      auto dest = Follow(vec->Data() + i * sizeof(uoffset_t));
+      if (elemobjectdef) {
+        MarkTable(*elemobjectdef, reinterpret_cast<Table *>(dest));
+      } else if (Visit(dest)) {
+        Mark(dest, sizeof(uoffset_t) +
+                   reinterpret_cast<String *>(dest)->Length() + 1);
+      }
+    }
+  }
+
+  // Where a location in the old buffer ends up in the new one.
+  uoffset_t Map(uoffset_t loc) const {
+    Range key = { loc, loc, 0 };
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), key);
+    assert(it != ranges_.begin());
+    --it;
+    assert(loc < it->end);
+    return loc - it->delta;
+  }
+
+  void Relocate() {
+    // Merge overlapping ranges (e.g. shared vtables), then assign each range
+    // the lowest new location that preserves its alignment.
+    std::sort(ranges_.begin(), ranges_.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges_.size(); i++) {
+      if (ranges_[i].start <= ranges_[merged].end) {
+        ranges_[merged].end = std::max(ranges_[merged].end, ranges_[i].end);
+      } else {
+        ranges_[++merged] = ranges_[i];
+      }
+    }
+    ranges_.resize(merged + 1);
+    uoffset_t cursor = 0;
+    for (auto it = ranges_.begin(); it != ranges_.end(); ++it) {
+      auto newstart = cursor + (it->start - cursor) % align_;
+      it->delta = it->start - static_cast<uoffset_t>(newstart);
+      cursor = static_cast<uoffset_t>(newstart) + it->end - it->start;
+    }
+    std::vector<uint8_t> newbuf(cursor + PaddingBytes(cursor, align_), 0);
+    for (auto it = ranges_.begin(); it != ranges_.end(); ++it) {
+      memcpy(newbuf.data() + it->start - it->delta, buf_.data() + it->start,
+             it->end - it->start);
+    }
+    for (auto it = offsets_.begin(); it != offsets_.end(); ++it) {
+      auto ref = *it + ReadScalar<uoffset_t>(buf_.data() + *it);
+      WriteScalar<uoffset_t>(newbuf.data() + Map(*it), Map(ref) - Map(*it));
+    }
+    for (auto it = tables_.begin(); it != tables_.end(); ++it) {
+      auto vtable = *it - ReadScalar<soffset_t>(buf_.data() + *it);
+      WriteScalar<soffset_t>(newbuf.data() + Map(*it),
+                             static_cast<soffset_t>(Map(*it)) -
+                             static_cast<soffset_t>(Map(vtable)));
+    }
+    buf_.swap(newbuf);
+  }
+
+  const reflection::Schema &schema_;
+  std::vector<uint8_t> &buf_;
+  std::vector<uint8_t> visited_;
+  size_t align_;
+  std::vector<Range> ranges_;
+  std::vector<uoffset_t> offsets_;  // Locations of all uoffset_t to rewrite.
+  std::vector<uoffset_t> tables_;   // Locations of all tables (vtable offset).
+};
+
+size_t CompactFlatBuffer(const reflection::Schema &schema,
+                         std::vector<uint8_t> *flatbuf,
+                         const reflection::Object *root_table) {
+  return CompactContext(schema, flatbuf).Compact(
+                               root_table ? *root_table : *schema.root_table());
+}
+
+// Tables created together typically share a vtable, so we only look up the
+// field again when the vtable changes.
+template<typename T> static void FillColumn(const Vector<Offset<Table>> &tables,
+                                            T dflt, Column *column) {
+  auto out = reinterpret_cast<T *>(column->data.data());
+  auto field = column->field->offset();
+  const uint8_t *vtable = nullptr;
+  voffset_t field_offset = 0;
+  for (uoffset_t i = 0; i < tables.size(); i++) {
+    auto table = tables.Get(i);
+    if (table->GetVTable() != vtable) {
+      vtable = table->GetVTable();
+      field_offset = table->GetOptionalFieldOffset(field);
+    }
+    if (field_offset) {
+      out[i] = ReadScalar<T>(reinterpret_cast<const uint8_t *>(table) +
+                             field_offset);
+      column->present[i / 8] |= static_cast<uint8_t>(1 << (i % 8));
+    } else {
+      out[i] = dflt;
+    }
+  }
+}
+
+bool ExportColumns(const reflection::Object &objectdef,
+                   const Vector<Offset<Table>> &tables,
+                   const std::vector<std::string> &field_names,
+                   std::vector<Column> *columns) {
+  columns->resize(field_names.size());
+  for (size_t i = 0; i < field_names.size(); i++) {
+    auto fielddef = objectdef.fields()->LookupByKey(field_names[i].c_str());
+    if (!fielddef) return false;
+    auto &column = (*columns)[i];
+    column.field = fielddef;
+    column.size = tables.size();
+    auto base_type = fielddef->type()->base_type();
+    if (base_type > reflection::Double) return false;
+    column.data.resize(tables.size() * GetTypeSize(base_type));
+    column.present.assign((tables.size() + 7) / 8, 0);
+    auto dflt = fielddef->default_integer();
+    auto dflt_real = fielddef->default_real();
+    switch (base_type) {
+      case reflection::UType:
+      case reflection::Bool:
+      case reflection::UByte:
+        FillColumn(tables, static_cast<uint8_t>(dflt), &column); break;
+      case reflection::Byte:
+        FillColumn(tables, static_cast<int8_t>(dflt), &column); break;
+      case reflection::Short:
+        FillColumn(tables, static_cast<int16_t>(dflt), &column); break;
+      case reflection::UShort:
+        FillColumn(tables, static_cast<uint16_t>(dflt), &column); break;
+      case reflection::Int:
+        FillColumn(tables, static_cast<int32_t>(dflt), &column); break;
+      case reflection::UInt:
+        FillColumn(tables, static_cast<uint32_t>(dflt), &column); break;
+      case reflection::Long:
+        FillColumn(tables, static_cast<int64_t>(dflt), &column); break;
+      case reflection::ULong:
+        FillColumn(tables, static_cast<uint64_t>(dflt), &column); break;
+      case reflection::Float:
+        FillColumn(tables, static_cast<float>(dflt_real), &column); break;
+      case reflection::Double:
+        FillColumn(tables, dflt_real, &column); break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+template<typename T> static uoffset_t CreateColumnVector(
+    FlatBufferBuilder &fbb, const Column &column) {
+  return fbb.CreateVector(column.Data<T>(), column.size).o;
+}
+
+Offset<const Table *> CreateColumnTable(FlatBufferBuilder &fbb,
+                                        const std::vector<Column> &columns) {
+  std::vector<uoffset_t> offsets;
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    uoffset_t offset = 0;
+    switch (it->field->type()->base_type()) {
+      case reflection::UType:
+      case reflection::Bool:
+      case reflection::UByte:
+        offset = CreateColumnVector<uint8_t>(fbb, *it); break;
+      case reflection::Byte:
+        offset = CreateColumnVector<int8_t>(fbb, *it); break;
+      case reflection::Short:
+        offset = CreateColumnVector<int16_t>(fbb, *it); break;
+      case reflection::UShort:
+        offset = CreateColumnVector<uint16_t>(fbb, *it); break;
+      case reflection::Int:
+        offset = CreateColumnVector<int32_t>(fbb, *it); break;
+      case reflection::UInt:
+        offset = CreateColumnVector<uint32_t>(fbb, *it); break;
+      case reflection::Long:
+        offset = CreateColumnVector<int64_t>(fbb, *it); break;
+      case reflection::ULong:
+        offset = CreateColumnVector<uint64_t>(fbb, *it); break;
+      case reflection::Float:
+        offset = CreateColumnVector<float>(fbb, *it); break;
+      case reflection::Double:
+        offset = CreateColumnVector<double>(fbb, *it); break;
+      default:
+        assert(false);
+    }
+    offsets.push_back(offset);
+  }
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    offsets.push_back(fbb.CreateVector(it->present).o);
+  }
+  auto start = fbb.StartTable();
+  for (size_t i = 0; i < offsets.size(); i++) {
+    fbb.AddOffset(FieldIndexToOffset(static_cast<voffset_t>(i)),
+                  Offset<void>(offsets[i]));
+  }
+  return fbb.EndTable(start, static_cast<voffset_t>(offsets.size()));
+}
+
 void CopyInline(FlatBufferBuilder &fbb, const reflection::Field &fielddef,
                 const Table &table, size_t align, size_t size) {
   fbb.Align(align);
@@ -348,124 +665,945 @@ void CopyInline(FlatBufferBuilder &fbb, const reflection::Field &fielddef,
   fbb.TrackField(fielddef.offset(), fbb.GetSize());
 }
 
-Offset<const Table *> CopyTable(FlatBufferBuilder &fbb,
-                                const reflection::Schema &schema,
-                                const reflection::Object &objectdef,
-                                const Table &table) {
-  // Before we can construct the table, we have to first generate any
-  // subobjects, and collect their offsets.
-  std::vector<uoffset_t> offsets;
-  auto fielddefs = objectdef.fields();
-  for (auto it = fielddefs->begin(); it != fielddefs->end(); ++it) {
-    auto &fielddef = **it;
-    // Skip if field is not present in the source.
-    if (!table.CheckField(fielddef.offset())) continue;
+// Copies tables, strings and vectors from a source FlatBuffer into a builder.
+// If "preserve_dags" is set, it remembers for every object copied where it
+// ended up in the builder, such that objects referred to more than once in the
+// source are also shared in the copy.
+// Tables may be copied with a FieldMask::Node, in which case only the fields
+// selected by it are copied.
+class CopyContext {
+ public:
+  CopyContext(FlatBufferBuilder &fbb, const reflection::Schema &schema,
+              bool preserve_dags)
+    : fbb_(fbb), schema_(schema), preserve_dags_(preserve_dags) {}
+
+  uoffset_t CopyString(const String *str) {
+    uoffset_t offset = 0;
+    if (Lookup(str, nullptr, &offset)) return offset;
+    return Remember(str, nullptr, fbb_.CreateString(str).o);
+  }
+
+  uoffset_t CopyVector(const reflection::Field &fielddef,
+                       const Vector<Offset<Table>> *vec,
+                       const FieldMask::Node *mask) {
     uoffset_t offset = 0;
-    switch (fielddef.type()->base_type()) {
+    if (Lookup(vec, mask, &offset)) return offset;
+    auto element_base_type = fielddef.type()->element();
+    auto elemobjectdef = element_base_type == reflection::Obj
+                         ? schema_.objects()->Get(fielddef.type()->index())
+                         : nullptr;
+    switch (element_base_type) {
       case reflection::String: {
-        offset = fbb.CreateString(GetFieldS(table, fielddef)).o;
+        std::vector<Offset<const String *>> elements(vec->size());
+        auto vec_s = reinterpret_cast<const Vector<Offset<String>> *>(vec);
+        for (uoffset_t i = 0; i < vec_s->size(); i++) {
+          elements[i] = CopyString(vec_s->Get(i));
+        }
+        offset = fbb_.CreateVector(elements).o;
         break;
       }
       case reflection::Obj: {
-        auto &subobjectdef = *schema.objects()->Get(fielddef.type()->index());
-        if (!subobjectdef.is_struct()) {
-          offset = CopyTable(fbb, schema, subobjectdef,
-                             *GetFieldT(table, fielddef)).o;
+        if (!elemobjectdef->is_struct()) {
+          std::vector<Offset<const Table *>> elements(vec->size());
+          for (uoffset_t i = 0; i < vec->size(); i++) {
+            elements[i] = CopyTable(*elemobjectdef, *vec->Get(i), mask);
+          }
+          offset = fbb_.CreateVector(elements).o;
+          break;
         }
-        break;
+        // FALL-THRU:
       }
-      case reflection::Union: {
-        auto &subobjectdef = GetUnionType(schema, objectdef, fielddef, table);
-        offset = CopyTable(fbb, schema, subobjectdef,
-                           *GetFieldT(table, fielddef)).o;
+      default: {  // Scalars and structs.
+        auto element_size = GetTypeSize(element_base_type);
+        if (elemobjectdef && elemobjectdef->is_struct())
+          element_size = elemobjectdef->bytesize();
+        fbb_.StartVector(element_size, vec->size());
+        fbb_.PushBytes(vec->Data(), element_size * vec->size());
+        offset = fbb_.EndVector(vec->size());
         break;
       }
-      case reflection::Vector: {
-        auto vec = table.GetPointer<const Vector<Offset<Table>> *>(
-                                                             fielddef.offset());
-        auto element_base_type = fielddef.type()->element();
-        auto elemobjectdef = element_base_type == reflection::Obj
-                             ? schema.objects()->Get(fielddef.type()->index())
-                             : nullptr;
-        switch (element_base_type) {
-          case reflection::String: {
-            std::vector<Offset<const String *>> elements(vec->size());
-            auto vec_s = reinterpret_cast<const Vector<Offset<String>> *>(vec);
-            for (uoffset_t i = 0; i < vec_s->size(); i++) {
-              elements[i] = fbb.CreateString(vec_s->Get(i)).o;
-            }
-            offset = fbb.CreateVector(elements).o;
-            break;
-          }
-          case reflection::Obj: {
-            if (!elemobjectdef->is_struct()) {
-              std::vector<Offset<const Table *>> elements(vec->size());
-              for (uoffset_t i = 0; i < vec->size(); i++) {
-                elements[i] =
-                  CopyTable(fbb, schema, *elemobjectdef, *vec->Get(i));
-              }
-              offset = fbb.CreateVector(elements).o;
-              break;
-            }
-            // FALL-THRU:
+    }
+    return Remember(vec, mask, offset);
+  }
+
+  Offset<const Table *> CopyTable(const reflection::Object &objectdef,
+                                  const Table &table,
+                                  const FieldMask::Node *mask = nullptr) {
+    uoffset_t memo = 0;
+    if (!objectdef.is_struct() && Lookup(&table, mask, &memo)) return memo;
+    // Without a mask we copy all fields, otherwise only the selected ones.
+    auto fielddefs = objectdef.fields();
+    auto numfields = mask ? mask->fields.size() : fielddefs->size();
+    // Before we can construct the table, we have to first generate any
+    // subobjects, and collect their offsets.
+    std::vector<uoffset_t> offsets;
+    for (size_t i = 0; i < numfields; i++) {
+      auto &fielddef = mask ? *mask->fields[i].field : *fielddefs->Get(i);
+      auto submask = mask ? mask->fields[i].sub : nullptr;
+      // Skip if field is not present in the source.
+      if (!table.CheckField(fielddef.offset())) continue;
+      uoffset_t offset = 0;
+      switch (fielddef.type()->base_type()) {
+        case reflection::String: {
+          offset = CopyString(GetFieldS(table, fielddef));
+          break;
+        }
+        case reflection::Obj: {
+          auto &subobjectdef =
+            *schema_.objects()->Get(fielddef.type()->index());
+          if (!subobjectdef.is_struct()) {
+            offset = CopyTable(subobjectdef, *GetFieldT(table, fielddef),
+                               submask).o;
           }
-          default: {  // Scalars and structs.
-            auto element_size = GetTypeSize(element_base_type);
-            if (elemobjectdef && elemobjectdef->is_struct())
-              element_size = elemobjectdef->bytesize();
-            fbb.StartVector(element_size, vec->size());
-            fbb.PushBytes(vec->Data(), element_size * vec->size());
-            offset = fbb.EndVector(vec->size());
+          break;
+        }
+        case reflection::Union: {
+          auto &subobjectdef = GetUnionType(schema_, objectdef, fielddef,
+                                            table);
+          offset = CopyTable(subobjectdef, *GetFieldT(table, fielddef)).o;
+          break;
+        }
+        case reflection::Vector: {
+          offset = CopyVector(fielddef,
+                     table.GetPointer<const Vector<Offset<Table>> *>(
+                                                            fielddef.offset()),
+                     submask);
+          break;
+        }
+        default:  // Scalars.
+          break;
+      }
+      if (offset) {
+        offsets.push_back(offset);
+      }
+    }
+    // Now we can build the actual table from either offsets or scalar data.
+    auto start = objectdef.is_struct()
+                   ? fbb_.StartStruct(objectdef.minalign())
+                   : fbb_.StartTable();
+    size_t offset_idx = 0;
+    for (size_t i = 0; i < numfields; i++) {
+      auto &fielddef = mask ? *mask->fields[i].field : *fielddefs->Get(i);
+      if (!table.CheckField(fielddef.offset())) continue;
+      auto base_type = fielddef.type()->base_type();
+      switch (base_type) {
+        case reflection::Obj: {
+          auto &subobjectdef =
+            *schema_.objects()->Get(fielddef.type()->index());
+          if (subobjectdef.is_struct()) {
+            CopyInline(fbb_, fielddef, table, subobjectdef.minalign(),
+                       subobjectdef.bytesize());
             break;
           }
+          // else: FALL-THRU:
+        }
+        case reflection::Union:
+        case reflection::String:
+        case reflection::Vector:
+          fbb_.AddOffset(fielddef.offset(),
+                         Offset<void>(offsets[offset_idx++]));
+          break;
+        default: { // Scalars.
+          auto size = GetTypeSize(base_type);
+          CopyInline(fbb_, fielddef, table, size, size);
+          break;
         }
-        break;
       }
-      default:  // Scalars.
-        break;
     }
-    if (offset) {
-      offsets.push_back(offset);
+    assert(offset_idx == offsets.size());
+    if (objectdef.is_struct()) {
+      fbb_.ClearOffsets();
+      return fbb_.EndStruct();
+    } else {
+      // A mask allows us to leave off the unused tail of the vtable.
+      auto vtable_size = mask ? mask->vtable_size
+                              : static_cast<voffset_t>(fielddefs->size());
+      return Remember(&table, mask, fbb_.EndTable(start, vtable_size));
     }
   }
-  // Now we can build the actual table from either offsets or scalar data.
-  auto start = objectdef.is_struct()
-                 ? fbb.StartStruct(objectdef.minalign())
-                 : fbb.StartTable();
-  size_t offset_idx = 0;
+
+  void operator=(const CopyContext &cc);
+
+ private:
+  // Objects copied with a mask differ from those copied without one (or with
+  // another mask), so we key on both.
+  typedef std::pair<const void *, const FieldMask::Node *> CopyKey;
+
+  // Returns true if "src" was copied before, and sets "offset" to its
+  // location in the builder.
+  bool Lookup(const void *src, const FieldMask::Node *mask,
+              uoffset_t *offset) const {
+    if (!preserve_dags_) return false;
+    auto it = copied_.find(CopyKey(src, mask));
+    if (it == copied_.end()) return false;
+    *offset = it->second;
+    return true;
+  }
+
+  uoffset_t Remember(const void *src, const FieldMask::Node *mask,
+                     uoffset_t offset) {
+    if (preserve_dags_) copied_[CopyKey(src, mask)] = offset;
+    return offset;
+  }
+
+  FlatBufferBuilder &fbb_;
+  const reflection::Schema &schema_;
+  bool preserve_dags_;
+  std::map<CopyKey, uoffset_t> copied_;
+};
+
+Offset<const Table *> CopyTable(FlatBufferBuilder &fbb,
+                                const reflection::Schema &schema,
+                                const reflection::Object &objectdef,
+                                const Table &table,
+                                bool preserve_dags) {
+  return CopyContext(fbb, schema, preserve_dags).CopyTable(objectdef, table);
+}
+
+FieldMask::FieldMask(const reflection::Schema &schema,
+                     const reflection::Object &objectdef)
+  : schema_(schema), objectdef_(objectdef) {
+  root_ = NewNode(objectdef);
+}
+
+FieldMask::~FieldMask() {
+  for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
+    delete *it;
+  }
+}
+
+FieldMask::Node *FieldMask::NewNode(const reflection::Object &objectdef) {
+  auto node = new Node();
+  node->vtable_size = 0;
+  nodes_.push_back(node);
+  // Required fields are always kept, such that the result still verifies.
+  auto fielddefs = objectdef.fields();
   for (auto it = fielddefs->begin(); it != fielddefs->end(); ++it) {
+    if ((*it)->required()) Select(node, **it);
+  }
+  return node;
+}
+
+FieldMask::Node::Field &FieldMask::Select(Node *node,
+                                          const reflection::Field &fielddef) {
+  // Keep fields in the order of their id, so the copy has the same field
+  // order as the schema.
+  auto it = node->fields.begin();
+  for (; it != node->fields.end(); ++it) {
+    if (it->field == &fielddef) return *it;
+    if (it->field->id() > fielddef.id()) break;
+  }
+  Node::Field field = { &fielddef, nullptr };
+  node->vtable_size = std::max(node->vtable_size,
+                               static_cast<voffset_t>(fielddef.id() + 1));
+  return *node->fields.insert(it, field);
+}
+
+bool FieldMask::Add(const std::string &path) {
+  // Resolve the whole path before selecting anything, such that a path that
+  // doesn't fit leaves the mask as it was.
+  std::vector<const reflection::Field *> fielddefs;
+  auto objectdef = &objectdef_;
+  for (size_t start = 0;;) {
+    auto dot = path.find('.', start);
+    auto name = path.substr(start, dot == std::string::npos
+                                     ? std::string::npos
+                                     : dot - start);
+    auto fielddef = objectdef->fields()->LookupByKey(name.c_str());
+    if (!fielddef) return false;
+    fielddefs.push_back(fielddef);
+    if (dot == std::string::npos) break;
+    // Check if we can continue into a subtable. Unions can only be selected
+    // whole.
+    auto type = fielddef->type();
+    auto is_table = (type->base_type() == reflection::Obj ||
+                     (type->base_type() == reflection::Vector &&
+                      type->element() == reflection::Obj)) &&
+                    !schema_.objects()->Get(type->index())->is_struct();
+    if (!is_table) return false;
+    objectdef = schema_.objects()->Get(type->index());
+    start = dot + 1;
+  }
+
+  objectdef = &objectdef_;
+  auto node = root_;
+  for (auto it = fielddefs.begin();; ++it) {
     auto &fielddef = **it;
-    if (!table.CheckField(fielddef.offset())) continue;
+    auto type = fielddef.type();
+    if (type->base_type() == reflection::Union) {
+      // Selected together with their type field.
+      auto type_field = objectdef->fields()->LookupByKey(
+                          (fielddef.name()->str() + "_type").c_str());
+      assert(type_field);
+      Select(node, *type_field);
+    }
+    auto known = node->fields.size();
+    auto &field = Select(node, fielddef);
+    auto is_new = known != node->fields.size();
+    if (it + 1 == fielddefs.end()) {
+      // Selected as a whole.
+      field.sub = nullptr;
+      return true;
+    }
+    // Already selected as a whole, so selecting part of it changes nothing.
+    if (!is_new && !field.sub) return true;
+    objectdef = schema_.objects()->Get(type->index());
+    if (!field.sub) field.sub = NewNode(*objectdef);
+    node = field.sub;
+  }
+}
+
+Offset<const Table *> ProjectTable(FlatBufferBuilder &fbb,
+                                   const FieldMask &mask,
+                                   const Table &table,
+                                   bool preserve_dags) {
+  return CopyContext(fbb, mask.schema(), preserve_dags).CopyTable(
+           mask.object(), table, mask.root());
+}
+
+// Finds a field by id rather than name.
+static const reflection::Field *GetFieldById(
+    const reflection::Object &objectdef, uoffset_t id) {
+  auto fielddefs = objectdef.fields();
+  for (auto it = fielddefs->begin(); it != fielddefs->end(); ++it) {
+    if (it->id() == id) return *it;
+  }
+  return nullptr;
+}
+
+// Walks the old and new buffer side by side, recording edits that turn one
+// into the other. Edits are kept in memory until the walk is done, since a
+// table that turns out to need replacing discards the edits made inside it.
+// Any edit that resizes must be followed directly by those filling in new
+// vector elements, since resizing walks the entire buffer.
+class DiffContext {
+ public:
+  DiffContext(const reflection::Schema &schema) : schema_(schema) {}
+
+  size_t Diff(FlatBufferBuilder &fbb, const reflection::Object &root_table,
+              const uint8_t *oldbuf, const uint8_t *newbuf) {
+    auto newroot = GetAnyRoot(newbuf);
+    if (!DiffTable(root_table, *GetAnyRoot(oldbuf), *newroot)) {
+      Replace(root_table, newroot);
+    }
+    std::vector<Offset<reflection::PatchEdit>> edits;
+    for (auto it = edits_.begin(); it != edits_.end(); ++it) {
+      edits.push_back(reflection::CreatePatchEdit(fbb, it->op,
+        fbb.CreateVector(it->path),
+        it->op == reflection::Resize ? 0 : fbb.CreateVector(it->data),
+        it->length));
+    }
+    reflection::FinishPatchBuffer(fbb,
+      reflection::CreatePatch(fbb, fbb.CreateVector(edits)));
+    return edits_.size();
+  }
+
+ private:
+  struct Edit {
+    reflection::PatchOp op;
+    std::vector<uint32_t> path;
+    std::vector<uint8_t> data;
+    uoffset_t length;
+  };
+
+  Edit &AddEdit(reflection::PatchOp op) {
+    edits_.push_back(Edit());
+    auto &edit = edits_.back();
+    edit.op = op;
+    edit.path = path_;
+    edit.length = 0;
+    return edit;
+  }
+
+  void SetBytes(const uint8_t *data, size_t size) {
+    AddEdit(reflection::SetBytes).data.assign(data, data + size);
+  }
+
+  void SetString(const String *str) {
+    AddEdit(reflection::SetString).data.assign(str->Data(),
+                                               str->Data() + str->size());
+  }
+
+  // Stores a copy of "obj", a table of type "objectdef" or a string if
+  // objectdef is nullptr.
+  void Replace(const reflection::Object *objectdef, const void *obj) {
+    FlatBufferBuilder fbb;
+    if (objectdef) {
+      fbb.Finish(CopyContext(fbb, schema_, true).CopyTable(*objectdef,
+                   *reinterpret_cast<const Table *>(obj)));
+    } else {
+      fbb.Finish(fbb.CreateString(reinterpret_cast<const String *>(obj)));
+    }
+    AddEdit(reflection::Replace).data.assign(fbb.GetBufferPointer(),
+                                             fbb.GetBufferPointer() +
+                                             fbb.GetSize());
+  }
+  void Replace(const reflection::Object &objectdef, const Table *table) {
+    Replace(&objectdef, table);
+  }
+
+  static bool Equal(const String *a, const String *b) {
+    return a->size() == b->size() && !memcmp(a->Data(), b->Data(), a->size());
+  }
+
+  // Scalars can be overwritten whenever the old table has room for them.
+  // A field that is not stored holds the default, so we compare (and write)
+  // its encoded default instead.
+  bool DiffScalar(const reflection::Field &fielddef, const Table &oldtable,
+                  const Table &newtable) {
+    auto base_type = fielddef.type()->base_type();
+    auto size = GetTypeSize(base_type);
+    uint8_t olddata[sizeof(largest_scalar_t)];
+    uint8_t newdata[sizeof(largest_scalar_t)];
+    auto oldloc = ScalarData(fielddef, oldtable, olddata);
+    auto newloc = ScalarData(fielddef, newtable, newdata);
+    if (!memcmp(oldloc, newloc, size)) return true;
+    if (!oldtable.CheckField(fielddef.offset())) return false;
+    SetBytes(newloc, size);
+    return true;
+  }
+
+  static const uint8_t *ScalarData(const reflection::Field &fielddef,
+                                   const Table &table, uint8_t *dflt) {
+    auto loc = table.GetAddressOf(fielddef.offset());
+    if (loc) return loc;
     auto base_type = fielddef.type()->base_type();
+    if (base_type == reflection::Float || base_type == reflection::Double) {
+      SetAnyValueF(base_type, dflt, fielddef.default_real());
+    } else {
+      SetAnyValueI(base_type, dflt, fielddef.default_integer());
+    }
+    return dflt;
+  }
+
+  // Returns false if "oldtable" can't be patched in-place to become
+  // "newtable", in which case the caller must replace it as a whole.
+  bool DiffTable(const reflection::Object &objectdef, const Table &oldtable,
+                 const Table &newtable) {
+    auto mark = edits_.size();
+    auto fielddefs = objectdef.fields();
+    for (auto it = fielddefs->begin(); it != fielddefs->end(); ++it) {
+      auto &fielddef = **it;
+      auto base_type = fielddef.type()->base_type();
+      // Handled together with their union below.
+      if (base_type == reflection::UType) continue;
+      path_.push_back(fielddef.id());
+      auto ok = DiffField(objectdef, fielddef, oldtable, newtable);
+      path_.pop_back();
+      if (!ok) {
+        edits_.resize(mark);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool DiffField(const reflection::Object &objectdef,
+                 const reflection::Field &fielddef, const Table &oldtable,
+                 const Table &newtable) {
+    auto base_type = fielddef.type()->base_type();
+    if (base_type <= reflection::Double)
+      return DiffScalar(fielddef, oldtable, newtable);
+    auto oldloc = oldtable.GetAddressOf(fielddef.offset());
+    auto newloc = newtable.GetAddressOf(fielddef.offset());
+    const reflection::Field *type_field = nullptr;
+    if (base_type == reflection::Union) {
+      type_field = objectdef.fields()->LookupByKey(
+                     (fielddef.name()->str() + "_type").c_str());
+      path_.back() = type_field->id();
+      auto ok = DiffScalar(*type_field, oldtable, newtable);
+      path_.back() = fielddef.id();
+      if (!ok) return false;
+    }
+    // Objects can't be added or removed in-place.
+    if (!oldloc || !newloc) return !oldloc && !newloc;
     switch (base_type) {
+      case reflection::String: {
+        auto newstr = GetFieldS(newtable, fielddef);
+        if (!Equal(GetFieldS(oldtable, fielddef), newstr)) SetString(newstr);
+        return true;
+      }
       case reflection::Obj: {
-        auto &subobjectdef = *schema.objects()->Get(fielddef.type()->index());
+        auto &subobjectdef = *schema_.objects()->Get(fielddef.type()->index());
         if (subobjectdef.is_struct()) {
-          CopyInline(fbb, fielddef, table, subobjectdef.minalign(),
-                     subobjectdef.bytesize());
-          break;
+          if (memcmp(oldloc, newloc, subobjectdef.bytesize()))
+            SetBytes(newloc, subobjectdef.bytesize());
+          return true;
         }
-        // else: FALL-THRU:
+        auto newsub = GetFieldT(newtable, fielddef);
+        if (!DiffTable(subobjectdef, *GetFieldT(oldtable, fielddef), *newsub))
+          Replace(subobjectdef, newsub);
+        return true;
+      }
+      case reflection::Union: {
+        auto &newobjectdef = GetUnionType(schema_, objectdef, fielddef,
+                                          newtable);
+        auto newsub = GetFieldT(newtable, fielddef);
+        if (GetFieldI<uint8_t>(oldtable, *type_field) !=
+              GetFieldI<uint8_t>(newtable, *type_field) ||
+            !DiffTable(newobjectdef, *GetFieldT(oldtable, fielddef), *newsub))
+          Replace(newobjectdef, newsub);
+        return true;
       }
-      case reflection::Union:
-      case reflection::String:
       case reflection::Vector:
-        fbb.AddOffset(fielddef.offset(), Offset<void>(offsets[offset_idx++]));
+        DiffVector(fielddef, *GetFieldAnyV(oldtable, fielddef),
+                   *GetFieldAnyV(newtable, fielddef));
+        return true;
+      default:
+        assert(false);
+        return false;
+    }
+  }
+
+  void DiffVector(const reflection::Field &fielddef, const VectorOfAny &oldvec,
+                  const VectorOfAny &newvec) {
+    auto elem_type = fielddef.type()->element();
+    auto elem_size = GetTypeSizeInline(elem_type, fielddef.type()->index(),
+                                       schema_);
+    auto elemobjectdef = elem_type == reflection::Obj
+                         ? schema_.objects()->Get(fielddef.type()->index())
+                         : nullptr;
+    auto oldsize = oldvec.size(), newsize = newvec.size();
+    if (oldsize != newsize) AddEdit(reflection::Resize).length = newsize;
+    if (elem_type == reflection::String || (elemobjectdef &&
+                                            !elemobjectdef->is_struct())) {
+      auto oldoffsets = reinterpret_cast<const Vector<uoffset_t> *>(&oldvec);
+      auto newoffsets = reinterpret_cast<const Vector<uoffset_t> *>(&newvec);
+      // Fill in new elements first, see above.
+      for (uoffset_t i = oldsize; i < newsize; i++) {
+        path_.push_back(i);
+        Replace(elemobjectdef, GetVectorElem(newoffsets, i));
+        path_.pop_back();
+      }
+      for (uoffset_t i = 0; i < std::min(oldsize, newsize); i++) {
+        path_.push_back(i);
+        auto oldelem = GetVectorElem(oldoffsets, i);
+        auto newelem = GetVectorElem(newoffsets, i);
+        if (elemobjectdef) {
+          if (!DiffTable(*elemobjectdef,
+                         *reinterpret_cast<const Table *>(oldelem),
+                         *reinterpret_cast<const Table *>(newelem)))
+            Replace(elemobjectdef, newelem);
+        } else {
+          auto newstr = reinterpret_cast<const String *>(newelem);
+          if (!Equal(reinterpret_cast<const String *>(oldelem), newstr))
+            SetString(newstr);
+        }
+        path_.pop_back();
+      }
+    } else {
+      // Scalars and structs: overwrite each run of changed elements. New
+      // elements start out as 0.
+      std::vector<uint8_t> zero(elem_size, 0);
+      for (uoffset_t i = 0; i < newsize; ) {
+        auto elem = newvec.Data() + i * elem_size;
+        auto old = i < oldsize ? oldvec.Data() + i * elem_size : zero.data();
+        if (!memcmp(old, elem, elem_size)) { i++; continue; }
+        auto start = i;
+        for (i++; i < newsize; i++) {
+          old = i < oldsize ? oldvec.Data() + i * elem_size : zero.data();
+          if (!memcmp(old, newvec.Data() + i * elem_size, elem_size)) break;
+        }
+        path_.push_back(start);
+        SetBytes(elem, (i - start) * elem_size);
+        path_.pop_back();
+      }
+    }
+  }
+
+  static const uint8_t *GetVectorElem(const Vector<uoffset_t> *vec,
+                                      uoffset_t i) {
+    auto loc = vec->Data() + i * sizeof(uoffset_t);
+    return loc + ReadScalar<uoffset_t>(loc);
+  }
+
+  const reflection::Schema &schema_;
+  std::vector<uint32_t> path_;
+  std::vector<Edit> edits_;
+};
+
+size_t DiffFlatBuffers(FlatBufferBuilder &fbb,
+                       const reflection::Schema &schema,
+                       const uint8_t *oldbuf, const uint8_t *newbuf,
+                       const reflection::Object *root_table) {
+  return DiffContext(schema).Diff(fbb,
+                                  root_table ? *root_table
+                                             : *schema.root_table(),
+                                  oldbuf, newbuf);
+}
+
+// The place in a buffer an edit's path leads to: the location of a table
+// field (nullptr if not stored), a vector element, or the root offset.
+struct PatchTarget {
+  uint8_t *loc;
+  reflection::BaseType base_type;  // Of the field or element at "loc".
+  const reflection::Type *type;    // nullptr for the root offset.
+  size_t inline_size;  // Bytes of scalar/struct data available at "loc".
+};
+
+static bool FindPatchTarget(const reflection::Schema &schema,
+                            const reflection::Object &root_table,
+                            const Vector<uint32_t> &path, uint8_t *flatbuf,
+                            PatchTarget *target) {
+  target->loc = flatbuf;
+  target->base_type = reflection::Obj;
+  target->type = nullptr;
+  target->inline_size = 0;
+  auto objectdef = &root_table;
+  auto table = GetAnyRoot(flatbuf);
+  for (uoffset_t i = 0; i < path.size(); i++) {
+    // Only tables can be walked into.
+    if (!table) return false;
+    auto fielddef = GetFieldById(*objectdef, path.Get(i));
+    if (!fielddef) return false;
+    auto type = fielddef->type();
+    auto parent = table;
+    table = nullptr;
+    target->loc = parent->GetAddressOf(fielddef->offset());
+    target->base_type = type->base_type();
+    target->type = type;
+    target->inline_size = target->base_type <= reflection::Double
+                          ? GetTypeSize(target->base_type) : 0;
+    if (target->base_type == reflection::Obj) {
+      objectdef = schema.objects()->Get(type->index());
+      if (objectdef->is_struct()) target->inline_size = objectdef->bytesize();
+    }
+    if (i + 1 == path.size()) break;
+    if (!target->loc) return false;
+    switch (target->base_type) {
+      case reflection::Obj:
+        if (!objectdef->is_struct()) table = GetFieldT(*parent, *fielddef);
+        break;
+      case reflection::Union:
+        objectdef = &GetUnionType(schema, *objectdef, *fielddef, *parent);
+        table = GetFieldT(*parent, *fielddef);
         break;
-      default: { // Scalars.
-        auto size = GetTypeSize(base_type);
-        CopyInline(fbb, fielddef, table, size, size);
+      case reflection::Vector: {
+        auto vec = GetFieldAnyV(*parent, *fielddef);
+        auto idx = path.Get(++i);
+        if (idx >= vec->size()) return false;
+        auto elem_size = GetTypeSizeInline(type->element(), type->index(),
+                                           schema);
+        target->loc = vec->Data() + idx * elem_size;
+        target->base_type = type->element();
+        target->inline_size = target->base_type <= reflection::Double
+                              ? (vec->size() - idx) * elem_size : 0;
+        if (target->base_type == reflection::Obj) {
+          objectdef = schema.objects()->Get(type->index());
+          if (objectdef->is_struct())
+            target->inline_size = (vec->size() - idx) * elem_size;
+          else
+            table = reinterpret_cast<Table *>(
+                      target->loc + ReadScalar<uoffset_t>(target->loc));
+        }
         break;
       }
+      default:
+        break;
     }
   }
-  assert(offset_idx == offsets.size());
-  if (objectdef.is_struct()) {
-    fbb.ClearOffsets();
-    return fbb.EndStruct();
+  return true;
+}
+
+bool ApplyFlatBufferPatch(const reflection::Schema &schema,
+                          const reflection::Patch &patch,
+                          std::vector<uint8_t> *flatbuf,
+                          const reflection::Object *root_table) {
+  auto &root = root_table ? *root_table : *schema.root_table();
+  auto edits = patch.edits();
+  if (!edits) return true;
+  for (auto it = edits->begin(); it != edits->end(); ++it) {
+    auto &edit = **it;
+    auto path = edit.path();
+    auto data = edit.data();
+    if (!path || (edit.op() != reflection::Resize && !data)) return false;
+    PatchTarget target;
+    if (!FindPatchTarget(schema, root, *path, flatbuf->data(), &target) ||
+        !target.loc)
+      return false;
+    // Everything but SetBytes refers to an object through an offset.
+    auto ref = target.inline_size
+               ? nullptr
+               : target.loc + ReadScalar<uoffset_t>(target.loc);
+    switch (edit.op()) {
+      case reflection::SetBytes:
+        // Must stay within the field, or the vector it starts in.
+        if (data->size() > target.inline_size) return false;
+        memcpy(target.loc, data->Data(), data->size());
+        break;
+      case reflection::SetString:
+        if (target.base_type != reflection::String) return false;
+        flatbuffers::SetString(schema,
+          std::string(reinterpret_cast<const char *>(data->Data()),
+                      data->size()),
+          reinterpret_cast<const String *>(ref), flatbuf, root_table);
+        break;
+      case reflection::Resize: {
+        if (target.base_type != reflection::Vector) return false;
+        auto vec = reinterpret_cast<const VectorOfAny *>(ref);
+        ResizeAnyVector(schema, edit.length(), vec, vec->size(),
+                        static_cast<uoffset_t>(GetTypeSizeInline(
+                          target.type->element(), target.type->index(),
+                          schema)),
+                        flatbuf, root_table);
+        break;
+      }
+      case reflection::Replace: {
+        if (target.inline_size ||
+            (target.base_type != reflection::Obj &&
+             target.base_type != reflection::Union &&
+             target.base_type != reflection::String))
+          return false;
+        auto newobj = AddFlatBuffer(*flatbuf, data->Data(), data->size()) -
+                      flatbuf->data();
+        // The buffer may have moved, so find the target again.
+        FindPatchTarget(schema, root, *path, flatbuf->data(), &target);
+        WriteScalar(target.loc, static_cast<uoffset_t>(
+                      flatbuf->data() + newobj - target.loc));
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+Predicate::Predicate(const reflection::Schema &schema,
+                     const reflection::Object &objectdef)
+  : schema_(schema), objectdef_(objectdef), cursor_(nullptr) {}
+
+bool Predicate::Compile(const std::string &expression) {
+  fields_.clear();
+  program_.clear();
+  error_.clear();
+  vtable_.clear();
+  field_offsets_.clear();
+  cursor_ = expression.c_str();
+  if (ParseOr()) {
+    SkipWhitespace();
+    if (!*cursor_) {
+      field_offsets_.assign(fields_.size(), 0);
+      return true;
+    }
+    Fail(std::string("unexpected: ") + cursor_);
+  }
+  // Leave nothing half parsed for Match() to run.
+  fields_.clear();
+  program_.clear();
+  return false;
+}
+
+bool Predicate::Fail(const std::string &msg) {
+  error_ = msg;
+  return false;
+}
+
+void Predicate::SkipWhitespace() {
+  while (isspace(static_cast<unsigned char>(*cursor_))) cursor_++;
+}
+
+bool Predicate::Expect(const char *token) {
+  SkipWhitespace();
+  auto len = strlen(token);
+  if (strncmp(cursor_, token, len)) return false;
+  cursor_ += len;
+  return true;
+}
+
+std::string Predicate::NextIdentifier() {
+  SkipWhitespace();
+  auto start = cursor_;
+  if (isalpha(static_cast<unsigned char>(*cursor_)) || *cursor_ == '_') {
+    while (isalnum(static_cast<unsigned char>(*cursor_)) || *cursor_ == '_')
+      cursor_++;
+  }
+  return std::string(start, cursor_);
+}
+
+// Each || (and &&) operand is followed by a jump to the end of the chain if
+// its result already decides the outcome.
+bool Predicate::ParseOr() {
+  if (!ParseAnd()) return false;
+  std::vector<size_t> jumps;
+  while (Expect("||")) {
+    jumps.push_back(program_.size());
+    program_.push_back(Instruction());
+    program_.back().op = kJumpIfTrue;
+    if (!ParseAnd()) return false;
+  }
+  for (auto it = jumps.begin(); it != jumps.end(); ++it)
+    program_[*it].target = program_.size();
+  return true;
+}
+
+bool Predicate::ParseAnd() {
+  if (!ParseUnary()) return false;
+  std::vector<size_t> jumps;
+  while (Expect("&&")) {
+    jumps.push_back(program_.size());
+    program_.push_back(Instruction());
+    program_.back().op = kJumpIfFalse;
+    if (!ParseUnary()) return false;
+  }
+  for (auto it = jumps.begin(); it != jumps.end(); ++it)
+    program_[*it].target = program_.size();
+  return true;
+}
+
+bool Predicate::ParseUnary() {
+  if (Expect("!")) {
+    if (!ParseUnary()) return false;
+    program_.push_back(Instruction());
+    program_.back().op = kNot;
+    return true;
+  }
+  if (Expect("(")) {
+    if (!ParseOr()) return false;
+    return Expect(")") || Fail("expecting: )");
+  }
+  return ParseComparison();
+}
+
+bool Predicate::ParseComparison() {
+  auto name = NextIdentifier();
+  if (name.empty()) return Fail("expecting: field name");
+  auto fielddef = objectdef_.fields()->LookupByKey(name.c_str());
+  if (!fielddef || fielddef->type()->base_type() > reflection::Double)
+    return Fail("not a scalar field: " + name);
+  Instruction ins = Instruction();
+  ins.op = kCompare;
+  auto it = std::find(fields_.begin(), fields_.end(), fielddef);
+  ins.field = it - fields_.begin();
+  if (it == fields_.end()) fields_.push_back(fielddef);
+  auto base_type = fielddef->type()->base_type();
+  ins.is_float = base_type == reflection::Float ||
+                 base_type == reflection::Double;
+  // Check longer operators first, since they start with shorter ones.
+  static const struct { const char *token; Comparison comparison; } ops[] = {
+    { "==", kEq }, { "!=", kNe }, { "<=", kLe }, { ">=", kGe },
+    { "<", kLt }, { ">", kGt }
+  };
+  ins.comparison = kNe;  // A field by itself is true if not 0.
+  bool has_value = false;
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (Expect(ops[i].token)) {
+      ins.comparison = ops[i].comparison;
+      has_value = true;
+      break;
+    }
+  }
+  if (has_value && !ParseValue(*fielddef, &ins)) return false;
+  program_.push_back(ins);
+  return true;
+}
+
+bool Predicate::ParseValue(const reflection::Field &fielddef,
+                           Instruction *ins) {
+  auto id = NextIdentifier();
+  if (!id.empty()) {
+    if (id == "true" || id == "false") {
+      ins->i = id == "true";
+    } else {
+      auto index = fielddef.type()->index();
+      if (index < 0) return Fail("unknown value: " + id);
+      auto values = schema_.enums()->Get(index)->values();
+      auto it = values->begin();
+      for (; it != values->end(); ++it) {
+        if (it->name()->str() == id) break;
+      }
+      if (it == values->end()) return Fail("unknown value: " + id);
+      ins->i = it->value();
+    }
+    ins->f = static_cast<double>(ins->i);
+    return true;
+  }
+  auto start = cursor_;
+  const char *end = nullptr;
+  ins->f = StringToFloat<double>(start, &end);
+  if (end == start) return Fail("expecting: value");
+  cursor_ = end;
+  // Integers are compared exactly, unless the field is a float.
+  if (std::find_if(start, cursor_, [](char c) {
+        return c == '.' || c == 'e' || c == 'E';
+      }) != cursor_) {
+    ins->is_float = true;
   } else {
-    return fbb.EndTable(start, static_cast<voffset_t>(fielddefs->size()));
+    ins->i = StringToInt(start);
+  }
+  return true;
+}
+
+void Predicate::LookupFields(const Table &table) {
+  auto vtable = table.GetVTable();
+  auto vtsize = ReadScalar<voffset_t>(vtable);
+  if (vtable_.size() == vtsize && !memcmp(vtable_.data(), vtable, vtsize))
+    return;
+  vtable_.assign(vtable, vtable + vtsize);
+  for (size_t i = 0; i < fields_.size(); i++) {
+    field_offsets_[i] = table.GetOptionalFieldOffset(fields_[i]->offset());
+  }
+}
+
+bool Predicate::Match(const Table &table) {
+  if (error_.length()) return false;  // Compile() failed.
+  LookupFields(table);
+  auto data = reinterpret_cast<const uint8_t *>(&table);
+  auto result = true;
+  for (size_t pc = 0; pc < program_.size(); ) {
+    auto &ins = program_[pc++];
+    switch (ins.op) {
+      case kCompare: {
+        auto &fielddef = *fields_[ins.field];
+        auto base_type = fielddef.type()->base_type();
+        auto field_offset = field_offsets_[ins.field];
+        int order;
+        if (ins.is_float) {
+          auto val = field_offset
+                     ? GetAnyValueF(base_type, data + field_offset)
+                     : fielddef.default_real();
+          // NaN is unordered, so only matches !=.
+          order = val < ins.f ? -1 : val > ins.f ? 1 : val == ins.f ? 0 : 2;
+        } else {
+          auto val = field_offset
+                     ? GetAnyValueI(base_type, data + field_offset)
+                     : fielddef.default_integer();
+          order = val < ins.i ? -1 : (val > ins.i ? 1 : 0);
+        }
+        switch (ins.comparison) {
+          case kEq: result = order == 0; break;
+          case kNe: result = order != 0; break;
+          case kLt: result = order == -1; break;
+          case kLe: result = order == -1 || order == 0; break;
+          case kGt: result = order == 1; break;
+          case kGe: result = order == 1 || order == 0; break;
+        }
+        break;
+      }
+      case kNot:
+        result = !result;
+        break;
+      case kJumpIfFalse:
+        if (!result) pc = ins.target;
+        break;
+      case kJumpIfTrue:
+        if (result) pc = ins.target;
+        break;
+    }
+  }
+  return result;
+}
+
+size_t Predicate::Filter(const uint8_t *const *buffers, size_t count,
+                         std::vector<size_t> *selected) {
+  size_t matched = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (Match(*GetAnyRoot(buffers[i]))) {
+      selected->push_back(i);
+      matched++;
+    }
   }
+  return matched;
 }
 
 }  // namespace flatbuffers
@@ -23,6 +23,7 @@
 #include "monster_test_generated.h"
 
 #include <random>
+#include <thread>
 
 using namespace MyGame::Example;
 
@@ -290,6 +291,208 @@ void ParseAndGenerateTextTest() {
   }
 }
 
+// Load a schema from its binary form instead of its text.
+void DeserializeTest() {
+  std::string schemafile;
+  std::string jsonfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.fbs", false, &schemafile), true);
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monsterdata_test.golden", false, &jsonfile), true);
+  flatbuffers::Parser text_parser;
+  const char *include_directories[] = { "tests", nullptr };
+  TEST_EQ(text_parser.Parse(schemafile.c_str(), include_directories), true);
+  text_parser.Serialize();
+  std::string bfbs(reinterpret_cast<const char *>(
+                     text_parser.builder_.GetBufferPointer()),
+                   text_parser.builder_.GetSize());
+
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Deserialize(*reflection::GetSchema(bfbs.c_str())), true);
+  TEST_EQ_STR(parser.file_identifier_.c_str(), "MONS");
+  TEST_EQ_STR(parser.file_extension_.c_str(), "mon");
+
+  // It parses and generates JSON the same as the text schema.
+  TEST_EQ(parser.Parse(jsonfile.c_str()), true);
+  flatbuffers::Verifier verifier(parser.builder_.GetBufferPointer(),
+                                 parser.builder_.GetSize());
+  TEST_EQ(VerifyMonsterBuffer(verifier), true);
+  std::string jsongen;
+  flatbuffers::GeneratorOptions opts;
+  GenerateText(parser, parser.builder_.GetBufferPointer(), opts, &jsongen);
+  TEST_EQ_STR(jsongen.c_str(), jsonfile.c_str());
+
+  // Nothing it holds is lost when serializing it again (though the layout
+  // may differ, as definitions are created in another order).
+  parser.Serialize();
+  auto schema = reflection::GetSchema(bfbs.c_str());
+  auto reserialized = reflection::GetSchema(parser.builder_.GetBufferPointer());
+  TEST_EQ(reserialized->objects()->size(), schema->objects()->size());
+  for (flatbuffers::uoffset_t i = 0; i < schema->objects()->size(); i++) {
+    auto a = schema->objects()->Get(i);
+    auto b = reserialized->objects()->Get(i);
+    TEST_EQ_STR(b->name()->c_str(), a->name()->c_str());
+    TEST_EQ(b->bytesize(), a->bytesize());
+    TEST_EQ(b->fields()->size(), a->fields()->size());
+    for (flatbuffers::uoffset_t j = 0; j < a->fields()->size(); j++) {
+      auto fa = a->fields()->Get(j);
+      auto fb = b->fields()->Get(j);
+      TEST_EQ_STR(fb->name()->c_str(), fa->name()->c_str());
+      TEST_EQ(fb->id(), fa->id());
+      TEST_EQ(fb->offset(), fa->offset());
+      TEST_EQ(fb->type()->index(), fa->type()->index());
+      TEST_EQ(fb->default_integer(), fa->default_integer());
+    }
+  }
+  TEST_EQ(reserialized->enums()->size(), schema->enums()->size());
+  TEST_EQ_STR(reserialized->root_table()->name()->c_str(), "Monster");
+
+  // Types can't be defined twice.
+  TEST_EQ(parser.Deserialize(*reflection::GetSchema(bfbs.c_str())), false);
+
+  // Malformed schemas that verify are rejected, rather than crashing later.
+  // These define struct V { x:int; y; } (y only if not None, referring to
+  // T if a table), table T { v; } and, if "member" isn't -1,
+  // union U { objects[member] }.
+  auto deserialize = [](reflection::BaseType base, reflection::BaseType elem,
+                        int index, reflection::BaseType y, int member,
+                        flatbuffers::Parser *parser) {
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<reflection::Field>> v_fields;
+    v_fields.push_back(reflection::CreateField(fbb, fbb.CreateString("x"),
+      reflection::CreateType(fbb, reflection::Int), 0, 0));
+    if (y != reflection::None)
+      v_fields.push_back(reflection::CreateField(fbb, fbb.CreateString("y"),
+        reflection::CreateType(fbb, y, reflection::None,
+                               y == reflection::Obj ? 1 : -1), 1, 4));
+    auto v = reflection::CreateObject(fbb, fbb.CreateString("V"),
+                                      fbb.CreateVector(v_fields), 1, 4,
+                                      y != reflection::None ? 8 : 4);
+    std::vector<flatbuffers::Offset<reflection::Field>> t_fields;
+    t_fields.push_back(reflection::CreateField(fbb, fbb.CreateString("v"),
+      reflection::CreateType(fbb, base, elem, index), 0, 4));
+    auto t = reflection::CreateObject(fbb, fbb.CreateString("T"),
+                                      fbb.CreateVector(t_fields), 0, 1, 0);
+    std::vector<flatbuffers::Offset<reflection::Object>> objects = { v, t };
+    std::vector<flatbuffers::Offset<reflection::Enum>> enums;
+    if (member >= 0) {
+      std::vector<flatbuffers::Offset<reflection::EnumVal>> vals;
+      vals.push_back(reflection::CreateEnumVal(fbb, fbb.CreateString("NONE"),
+                                               0));
+      vals.push_back(reflection::CreateEnumVal(fbb, fbb.CreateString("M"), 1,
+                                               objects[member]));
+      enums.push_back(reflection::CreateEnum(fbb, fbb.CreateString("U"),
+        fbb.CreateVector(vals), 1,
+        reflection::CreateType(fbb, reflection::UType, reflection::None, 0)));
+    }
+    fbb.Finish(reflection::CreateSchema(fbb, fbb.CreateVector(objects),
+                                        fbb.CreateVector(enums), 0, 0, t));
+    flatbuffers::Verifier verifier(fbb.GetBufferPointer(), fbb.GetSize());
+    TEST_EQ(reflection::VerifySchemaBuffer(verifier), true);
+    return parser->Deserialize(*reflection::GetSchema(fbb.GetBufferPointer()));
+  };
+  {
+    flatbuffers::Parser ok;
+    TEST_EQ(deserialize(reflection::Obj, reflection::None, 0, reflection::None,
+                        -1, &ok), true);
+    TEST_EQ(ok.Parse("{ v: { x: 1 } }"), true);
+  }
+  struct Malformed {
+    reflection::BaseType base, elem;
+    int index;
+    reflection::BaseType y;
+    int member;
+    const char *error;
+  } malformed[] = {
+    { reflection::Obj, reflection::None, -1, reflection::None, -1,
+      "missing type index" },
+    { reflection::Vector, reflection::Obj, -1, reflection::None, -1,
+      "missing type index" },
+    { reflection::Union, reflection::None, -1, reflection::None, 0,
+      "missing type index" },
+    { reflection::UType, reflection::None, -1, reflection::None, 0,
+      "missing type index" },
+    { reflection::Obj, reflection::None, 0, reflection::String, -1,
+      "structs may contain only scalar or struct fields: V.y" },
+    { reflection::Obj, reflection::None, 0, reflection::Obj, -1,
+      "structs may contain only scalar or struct fields: V.y" },
+    { reflection::Union, reflection::None, 0, reflection::None, 0,
+      "union members must be tables: M" },
+  };
+  for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+    auto &m = malformed[i];
+    flatbuffers::Parser bad;
+    TEST_EQ(deserialize(m.base, m.elem, m.index, m.y, m.member, &bad), false);
+    TEST_EQ(bad.error_.find(m.error) != std::string::npos, true);
+  }
+}
+
+// Schemas parsed once, until their files change.
+void SchemaCacheTest() {
+  flatbuffers::SchemaCache cache;
+  const char *include_directories[] = { "tests", nullptr };
+  std::string error;
+  auto schema = cache.Get("tests/monster_test.fbs", include_directories,
+                          &error);
+  TEST_NOTNULL(schema.get());
+  TEST_EQ(cache.Get("tests/monster_test.fbs", include_directories,
+                    &error).get(), schema.get());
+  flatbuffers::Parser parser(schema.get());
+  TEST_EQ(parser.Parse("{ name: \"A\" }"), true);
+  TEST_EQ(cache.Get("tests/none.fbs", include_directories, &error).get(),
+          static_cast<const flatbuffers::Parser *>(nullptr));
+  TEST_EQ(error.find("unable to load file") == 0, true);
+
+  // Changing the file gets it parsed again.
+  const char *filename = "schema_cache_test.fbs";
+  TEST_EQ(flatbuffers::SaveFile(filename, std::string("table A {}"), false),
+          true);
+  auto a = cache.Get(filename, nullptr, &error);
+  TEST_NOTNULL(a.get());
+  TEST_EQ(flatbuffers::SaveFile(filename, std::string("table B {}"), false),
+          true);
+  auto b = cache.Get(filename, nullptr, &error);
+  TEST_NOTNULL(b.get());
+  TEST_EQ(b.get() != a.get(), true);
+  TEST_NOTNULL(a->structs_.Lookup("A"));
+  TEST_NOTNULL(b->structs_.Lookup("B"));
+  remove(filename);
+
+  // Concurrent gets of the same schema parse it only once, while other
+  // schemas are got (and failures reported) alongside.
+  cache.Clear();
+  const int kThreads = 8;
+  std::shared_ptr<const flatbuffers::Parser> results[kThreads];
+  std::string errors[kThreads];
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.push_back(std::thread([&, i]() {
+      results[i] = cache.Get(i % 2 ? "tests/monster_test.fbs"
+                                   : "tests/monster_test.bfbs",
+                             include_directories, &errors[i]);
+    }));
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+  for (int i = 0; i < kThreads; i++) {
+    TEST_NOTNULL(results[i].get());
+    TEST_EQ(results[i].get(), results[i % 2].get());
+  }
+  TEST_EQ(results[0].get() != results[1].get(), true);
+  threads.clear();
+  for (int i = 0; i < kThreads; i++) {
+    threads.push_back(std::thread([&, i]() {
+      results[i] = cache.Get("tests/none.fbs", include_directories,
+                             &errors[i]);
+    }));
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it) it->join();
+  for (int i = 0; i < kThreads; i++) {
+    TEST_EQ(results[i].get(),
+            static_cast<const flatbuffers::Parser *>(nullptr));
+    TEST_EQ(errors[i].find("unable to load file") == 0, true);
+  }
+}
+
 void ReflectionTest(uint8_t *flatbuf, size_t length) {
   // Load a binary schema.
   std::string bfbsfile;
@@ -405,6 +608,24 @@ void ReflectionTest(uint8_t *flatbuf, size_t length) {
   SetFieldT(*rroot, name_field, string_ptr);
   TEST_EQ_STR(GetFieldS(**rroot, name_field)->c_str(), "hank");
 
+  // The string we replaced above is now garbage, as it is no longer referred
+  // to. Compacting the buffer gets rid of it, without changing the contents.
+  auto reclaimed = flatbuffers::CompactFlatBuffer(schema, &resizingbuf);
+  TEST_EQ(reclaimed >= strlen("totally new string"), true);
+  flatbuffers::Verifier compact_verifier(resizingbuf.data(),
+                                         resizingbuf.size());
+  TEST_EQ(VerifyMonsterBuffer(compact_verifier), true);
+  auto compacted = GetMonster(resizingbuf.data());
+  TEST_EQ_STR(compacted->name()->c_str(), "hank");
+  TEST_EQ(compacted->inventory()->size(), 110U);
+  TEST_EQ(compacted->inventory()->Get(10), 50);
+  TEST_EQ(compacted->testarrayofstring()->Get(2) == compacted->name(), true);
+  TEST_EQ(compacted->pos()->test3().b(), 20);
+  TEST_EQ_STR(compacted->testarrayoftables()->Get(2)->name()->c_str(),
+              "Wilma");
+  // Nothing left to reclaim the second time.
+  TEST_EQ(flatbuffers::CompactFlatBuffer(schema, &resizingbuf), 0U);
+
   // Using reflection, rather than mutating binary FlatBuffers, we can also copy
   // tables and other things out of other FlatBuffers into a FlatBufferBuilder,
   // either part or whole.
@@ -416,6 +637,689 @@ void ReflectionTest(uint8_t *flatbuf, size_t length) {
   AccessFlatBufferTest(fbb.GetBufferPointer(), fbb.GetSize());
 }
 
+// Copy a buffer in which objects are referred to more than once, both as a
+// tree and as a DAG.
+void CopyTableDAGTest() {
+  std::string bfbsfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.bfbs", true, &bfbsfile), true);
+  auto &schema = *reflection::GetSchema(bfbsfile.c_str());
+
+  // Build a buffer where one monster and one string are shared.
+  flatbuffers::FlatBufferBuilder builder;
+  auto name = builder.CreateString("Shared");
+  auto shared = CreateMonster(builder, nullptr, 150, 100, name);
+  flatbuffers::Offset<flatbuffers::String> strings[] = { name, name };
+  auto vecofstrings = builder.CreateVector(strings, 2);
+  flatbuffers::Offset<Monster> tables[] = { shared, shared };
+  auto vecoftables = builder.CreateVector(tables, 2);
+  auto root = CreateMonster(builder, nullptr, 150, 80, name, 0, Color_Blue,
+                            Any_Monster, shared.Union(), 0, vecofstrings,
+                            vecoftables, shared);
+  FinishMonsterBuffer(builder, root);
+
+  // Copying it as a tree duplicates everything that was shared.
+  flatbuffers::FlatBufferBuilder treefbb;
+  treefbb.Finish(flatbuffers::CopyTable(treefbb, schema, *schema.root_table(),
+                   *flatbuffers::GetAnyRoot(builder.GetBufferPointer())),
+                 MonsterIdentifier());
+  auto tree = GetMonster(treefbb.GetBufferPointer());
+  TEST_EQ(tree->enemy() == tree->testarrayoftables()->Get(0), false);
+  TEST_EQ(treefbb.GetSize() > builder.GetSize(), true);
+
+  // Copying it as a DAG keeps the sharing intact.
+  flatbuffers::FlatBufferBuilder dagfbb;
+  dagfbb.Finish(flatbuffers::CopyTable(dagfbb, schema, *schema.root_table(),
+                  *flatbuffers::GetAnyRoot(builder.GetBufferPointer()), true),
+                MonsterIdentifier());
+  flatbuffers::Verifier verifier(dagfbb.GetBufferPointer(), dagfbb.GetSize());
+  TEST_EQ(VerifyMonsterBuffer(verifier), true);
+  TEST_EQ(dagfbb.GetSize() < treefbb.GetSize(), true);
+  auto dag = GetMonster(dagfbb.GetBufferPointer());
+  TEST_EQ_STR(dag->enemy()->name()->c_str(), "Shared");
+  TEST_EQ(dag->enemy() == dag->testarrayoftables()->Get(0), true);
+  TEST_EQ(dag->enemy() == dag->testarrayoftables()->Get(1), true);
+  TEST_EQ(dag->enemy() == dag->test(), true);
+  TEST_EQ(dag->name() == dag->enemy()->name(), true);
+  TEST_EQ(dag->name() == dag->testarrayofstring()->Get(1), true);
+}
+
+// Copy only some of the fields of a buffer into a new one.
+void ProjectTableTest(const uint8_t *flatbuf) {
+  std::string bfbsfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.bfbs", true, &bfbsfile), true);
+  auto &schema = *reflection::GetSchema(bfbsfile.c_str());
+
+  flatbuffers::FieldMask mask(schema, *schema.root_table());
+  TEST_EQ(mask.Add("hp"), true);
+  TEST_EQ(mask.Add("pos"), true);
+  TEST_EQ(mask.Add("test"), true);
+  TEST_EQ(mask.Add("testarrayoftables.hp"), true);
+  TEST_EQ(mask.Add("nosuchfield"), false);
+  TEST_EQ(mask.Add("hp.x"), false);
+  TEST_EQ(mask.Add("pos.x"), false);
+  TEST_EQ(mask.Add("test.name"), false);
+
+  // Paths that fail to add leave the mask as it was, with just the required
+  // fields.
+  flatbuffers::FieldMask failed(schema, *schema.root_table());
+  auto required = failed.root()->fields.size();
+  TEST_EQ(failed.Add("hp.x"), false);
+  TEST_EQ(failed.Add("testarrayoftables.nosuch"), false);
+  TEST_EQ(failed.Add("test.name"), false);
+  TEST_EQ(failed.root()->fields.size(), required);
+  for (auto it = failed.root()->fields.begin();
+       it != failed.root()->fields.end(); ++it)
+    TEST_EQ(it->field->required(), true);
+
+  // The same mask can be used for any number of projections.
+  for (int i = 0; i < 2; i++) {
+    flatbuffers::FlatBufferBuilder fbb;
+    fbb.Finish(flatbuffers::ProjectTable(fbb, mask,
+                                         *flatbuffers::GetAnyRoot(flatbuf)),
+               MonsterIdentifier());
+    flatbuffers::Verifier verifier(fbb.GetBufferPointer(), fbb.GetSize());
+    TEST_EQ(VerifyMonsterBuffer(verifier), true);
+    auto monster = GetMonster(fbb.GetBufferPointer());
+    TEST_EQ(monster->hp(), 80);
+    TEST_EQ(monster->pos()->test3().a(), 10);
+    TEST_EQ_STR(monster->name()->c_str(), "MyMonster");  // Required.
+    TEST_EQ(monster->test_type(), Any_Monster);
+    TEST_EQ_STR(reinterpret_cast<const Monster *>(monster->test())->name()->
+                  c_str(), "Fred");
+    TEST_EQ(monster->inventory() == nullptr, true);
+    TEST_EQ(monster->test4() == nullptr, true);
+    TEST_EQ(monster->testarrayofstring() == nullptr, true);
+    auto vecoftables = monster->testarrayoftables();
+    TEST_EQ(vecoftables->Length(), 3U);
+    TEST_EQ_STR(vecoftables->Get(1)->name()->c_str(), "Fred");
+  }
+}
+
+// Compute the differences between two buffers, and patch one into the other.
+void PatchTest(const uint8_t *flatbuf, size_t length) {
+  std::string bfbsfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.bfbs", true, &bfbsfile), true);
+  auto &schema = *reflection::GetSchema(bfbsfile.c_str());
+  auto fields = schema.root_table()->fields();
+
+  // Make a changed copy of the buffer.
+  std::vector<uint8_t> newbuf(flatbuf, flatbuf + length);
+  auto root = flatbuffers::piv(flatbuffers::GetAnyRoot(newbuf.data()), newbuf);
+  flatbuffers::SetField<uint16_t>(*root, *fields->LookupByKey("hp"), 200);
+  SetString(schema, "Alfred", GetFieldS(**root, *fields->LookupByKey("name")),
+            &newbuf);
+  flatbuffers::ResizeVector<uint8_t>(schema, 12, 42,
+    flatbuffers::GetFieldV<uint8_t>(**root, *fields->LookupByKey("inventory")),
+    &newbuf);
+  flatbuffers::ResizeVector<flatbuffers::Offset<flatbuffers::String>>(
+    schema, 1, 0,
+    flatbuffers::GetFieldV<flatbuffers::Offset<flatbuffers::String>>(
+      **root, *fields->LookupByKey("testarrayofstring")),
+    &newbuf);
+  // Barney gains a field, so will have to be sent as a whole.
+  flatbuffers::FlatBufferBuilder barneyfbb;
+  auto barneyname = barneyfbb.CreateString("Barney");
+  MonsterBuilder mb(barneyfbb);
+  mb.add_name(barneyname);
+  mb.add_hp(42);
+  barneyfbb.Finish(mb.Finish());
+  auto barney = flatbuffers::AddFlatBuffer(newbuf,
+                                           barneyfbb.GetBufferPointer(),
+                                           barneyfbb.GetSize());
+  GetMutableMonster(newbuf.data())->mutable_testarrayoftables()->
+    MutateOffset(0, barney);
+
+  flatbuffers::FlatBufferBuilder patchfbb;
+  TEST_EQ(flatbuffers::DiffFlatBuffers(patchfbb, schema, flatbuf,
+                                       newbuf.data()) > 0, true);
+  flatbuffers::Verifier verifier(patchfbb.GetBufferPointer(),
+                                 patchfbb.GetSize());
+  TEST_EQ(reflection::VerifyPatchBuffer(verifier), true);
+  TEST_EQ(patchfbb.GetSize() < newbuf.size(), true);
+
+  std::vector<uint8_t> patched(flatbuf, flatbuf + length);
+  TEST_EQ(flatbuffers::ApplyFlatBufferPatch(schema,
+            *reflection::GetPatch(patchfbb.GetBufferPointer()), &patched),
+          true);
+  flatbuffers::Verifier patched_verifier(patched.data(), patched.size());
+  TEST_EQ(VerifyMonsterBuffer(patched_verifier), true);
+  auto monster = GetMonster(patched.data());
+  TEST_EQ(monster->hp(), 200);
+  TEST_EQ_STR(monster->name()->c_str(), "Alfred");
+  TEST_EQ(monster->inventory()->size(), 12U);
+  TEST_EQ(monster->inventory()->Get(9), 9);
+  TEST_EQ(monster->inventory()->Get(11), 42);
+  TEST_EQ(monster->testarrayofstring()->size(), 1U);
+  TEST_EQ(monster->testarrayoftables()->Get(0)->hp(), 42);
+  TEST_EQ_STR(monster->testarrayoftables()->Get(0)->name()->c_str(),
+              "Barney");
+  TEST_EQ_STR(monster->testarrayoftables()->Get(1)->name()->c_str(), "Fred");
+  TEST_EQ(monster->pos()->test3().a(), 10);
+
+  // Nothing left to patch.
+  flatbuffers::FlatBufferBuilder emptyfbb;
+  TEST_EQ(flatbuffers::DiffFlatBuffers(emptyfbb, schema, patched.data(),
+                                       newbuf.data()), 0U);
+
+  // And back again, which needs fields reset to their defaults.
+  flatbuffers::FlatBufferBuilder undofbb;
+  TEST_EQ(flatbuffers::DiffFlatBuffers(undofbb, schema, newbuf.data(),
+                                       flatbuf) > 0, true);
+  TEST_EQ(flatbuffers::ApplyFlatBufferPatch(schema,
+            *reflection::GetPatch(undofbb.GetBufferPointer()), &patched),
+          true);
+  flatbuffers::CompactFlatBuffer(schema, &patched);
+  flatbuffers::Verifier undone_verifier(patched.data(), patched.size());
+  TEST_EQ(VerifyMonsterBuffer(undone_verifier), true);
+  flatbuffers::FlatBufferBuilder samefbb;
+  TEST_EQ(flatbuffers::DiffFlatBuffers(samefbb, schema, patched.data(),
+                                       flatbuf), 0U);
+  TEST_EQ(GetMonster(patched.data())->testarrayoftables()->Get(0)->hp(), 100);
+}
+
+// Turn fields of a vector of tables into arrays of values.
+void ColumnsTest() {
+  std::string bfbsfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.bfbs", true, &bfbsfile), true);
+  auto &schema = *reflection::GetSchema(bfbsfile.c_str());
+
+  // Every other monster has its hp set, the others have the default.
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<flatbuffers::Offset<Monster>> monsters;
+  for (int i = 0; i < 20; i++) {
+    auto name = builder.CreateString(flatbuffers::NumToString(i));
+    MonsterBuilder mb(builder);
+    mb.add_name(name);
+    if (i % 2) mb.add_hp(static_cast<int16_t>(i));
+    monsters.push_back(mb.Finish());
+  }
+  auto vecoftables = builder.CreateVector(monsters);
+  auto name = builder.CreateString("Columns");
+  MonsterBuilder mb(builder);
+  mb.add_name(name);
+  mb.add_testarrayoftables(vecoftables);
+  FinishMonsterBuffer(builder, mb.Finish());
+  auto tables = reinterpret_cast<
+    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::Table>> *>(
+      GetMonster(builder.GetBufferPointer())->testarrayoftables());
+
+  std::vector<flatbuffers::Column> columns;
+  std::vector<std::string> field_names;
+  field_names.push_back("name");
+  TEST_EQ(flatbuffers::ExportColumns(*schema.root_table(), *tables,
+                                     field_names, &columns), false);
+  field_names[0] = "hp";
+  field_names.push_back("color");
+  TEST_EQ(flatbuffers::ExportColumns(*schema.root_table(), *tables,
+                                     field_names, &columns), true);
+  TEST_EQ(columns.size(), 2U);
+  auto hp = columns[0].Data<int16_t>();
+  TEST_EQ(columns[0].size, 20U);
+  TEST_EQ(hp[0], 100);
+  TEST_EQ(hp[19], 19);
+  TEST_EQ(columns[0].IsPresent(0), false);
+  TEST_EQ(columns[0].IsPresent(19), true);
+  TEST_EQ(columns[1].Data<int8_t>()[7], Color_Blue);
+  TEST_EQ(columns[1].IsPresent(7), false);
+
+  // Generated code can do the same with its accessors.
+  std::vector<int16_t> hps;
+  flatbuffers::ExportColumn(*GetMonster(builder.GetBufferPointer())->
+                              testarrayoftables(), &Monster::hp, &hps);
+  TEST_EQ(hps.size(), 20U);
+  TEST_EQ(memcmp(hps.data(), hp, 20 * sizeof(int16_t)), 0);
+
+  // The columns can be stored as a FlatBuffer of their own.
+  flatbuffers::FlatBufferBuilder columnfbb;
+  columnfbb.Finish(flatbuffers::CreateColumnTable(columnfbb, columns));
+  auto columntable = flatbuffers::GetAnyRoot(columnfbb.GetBufferPointer());
+  auto hpvec = columntable->GetPointer<const flatbuffers::Vector<int16_t> *>(
+                 flatbuffers::FieldIndexToOffset(0));
+  TEST_EQ(hpvec->size(), 20U);
+  TEST_EQ(hpvec->Get(9), 9);
+  TEST_EQ(hpvec->Get(10), 100);
+  auto hppresent =
+    columntable->GetPointer<const flatbuffers::Vector<uint8_t> *>(
+      flatbuffers::FieldIndexToOffset(2));
+  TEST_EQ(hppresent->size(), 3U);
+  TEST_EQ(hppresent->Get(0), 0xAA);
+}
+
+// Select buffers with a predicate on their fields.
+void PredicateTest() {
+  std::string bfbsfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.bfbs", true, &bfbsfile), true);
+  auto &schema = *reflection::GetSchema(bfbsfile.c_str());
+
+  // Monsters with hp 0, 10, .. 90, alternating between Red and the default
+  // (Blue), and with testbool set on every third one.
+  std::vector<std::string> buffers;
+  std::vector<const uint8_t *> buffer_ptrs;
+  for (int i = 0; i < 10; i++) {
+    flatbuffers::FlatBufferBuilder builder;
+    auto name = builder.CreateString("Monster");
+    MonsterBuilder mb(builder);
+    mb.add_name(name);
+    mb.add_hp(static_cast<int16_t>(i * 10));
+    if (i % 2) mb.add_color(Color_Red);
+    if (i % 3 == 0) mb.add_testbool(true);
+    FinishMonsterBuffer(builder, mb.Finish());
+    buffers.push_back(std::string(
+      reinterpret_cast<const char *>(builder.GetBufferPointer()),
+      builder.GetSize()));
+  }
+  for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+    buffer_ptrs.push_back(reinterpret_cast<const uint8_t *>(it->c_str()));
+  }
+
+  flatbuffers::Predicate predicate(schema, *schema.root_table());
+  std::vector<size_t> selected;
+  TEST_EQ(predicate.Compile("hp > 50 && color == Blue"), true);
+  TEST_EQ(predicate.Filter(buffer_ptrs.data(), buffer_ptrs.size(), &selected),
+          2U);
+  TEST_EQ(selected[0], 6U);
+  TEST_EQ(selected[1], 8U);
+
+  selected.clear();
+  TEST_EQ(predicate.Compile("!(hp >= 20) || (testbool && mana == 150)"),
+          true);
+  TEST_EQ(predicate.Filter(buffer_ptrs.data(), buffer_ptrs.size(), &selected),
+          5U);
+  TEST_EQ(selected[0], 0U);
+  TEST_EQ(selected[1], 1U);
+  TEST_EQ(selected[2], 3U);
+  TEST_EQ(selected[4], 9U);
+
+  TEST_EQ(predicate.Compile("hp <= 10.5 || testhashu64_fnv1 != 0"), true);
+  TEST_EQ(predicate.Match(*flatbuffers::GetAnyRoot(buffer_ptrs[1])), true);
+  TEST_EQ(predicate.Match(*flatbuffers::GetAnyRoot(buffer_ptrs[2])), false);
+
+  TEST_EQ(predicate.Compile("name == 1"), false);
+  TEST_EQ(predicate.Compile("color == Purple"), false);
+  TEST_EQ(predicate.Compile("(hp > 1"), false);
+  TEST_EQ(predicate.Compile("hp > 1 hp"), false);
+
+  // A failed compile, having parsed more fields than the last good one,
+  // matches nothing until the next good one.
+  TEST_EQ(predicate.Compile("hp > 1 && mana > 1 && testbool && color == X"),
+          false);
+  TEST_EQ(predicate.Match(*flatbuffers::GetAnyRoot(buffer_ptrs[3])), false);
+  selected.clear();
+  TEST_EQ(predicate.Filter(buffer_ptrs.data(), buffer_ptrs.size(), &selected),
+          0U);
+  TEST_EQ(predicate.Compile("hp == 30"), true);
+  TEST_EQ(predicate.Match(*flatbuffers::GetAnyRoot(buffer_ptrs[3])), true);
+}
+
+// Parse any number of JSON objects in a row, with a single schema parse.
+void JsonStreamTest() {
+  std::string schemafile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.fbs", false, &schemafile), true);
+  flatbuffers::Parser parser;
+  const char *include_directories[] = { "tests", nullptr };
+  TEST_EQ(parser.Parse(schemafile.c_str(), include_directories), true);
+
+  parser.StartJsonStream("{ name: \"A\", hp: 1 }\n"
+                         "{ name: \"B\", hp: 2 }\n"
+                         "\n"
+                         "{ name: \"C\" }\n");
+  std::string names;
+  int hp = 0;
+  while (parser.ParseNextJson()) {
+    flatbuffers::Verifier verifier(parser.builder_.GetBufferPointer(),
+                                   parser.builder_.GetSize());
+    TEST_EQ(VerifyMonsterBuffer(verifier), true);
+    auto monster = GetMonster(parser.builder_.GetBufferPointer());
+    names += monster->name()->c_str();
+    hp += monster->hp();
+  }
+  TEST_EQ(parser.error_.empty(), true);
+  TEST_EQ_STR(names.c_str(), "ABC");
+  TEST_EQ(hp, 103);
+
+  // An error ends the stream, but the parser can be used for another one.
+  parser.StartJsonStream("{ name: \"A\" }\n"
+                         "{ name: \"B\", hp: 1, hp: 2 }\n"
+                         "{ name: \"C\" }\n");
+  TEST_EQ(parser.ParseNextJson(), true);
+  TEST_EQ(parser.ParseNextJson(), false);
+  TEST_EQ(parser.error_.find("more than once") != std::string::npos, true);
+  TEST_EQ(parser.ParseNextJson(), false);
+  parser.StartJsonStream("{ name: \"D\", hp: 4 }");
+  TEST_EQ(parser.ParseNextJson(), true);
+  TEST_EQ(GetMonster(parser.builder_.GetBufferPointer())->hp(), 4);
+  TEST_EQ(parser.ParseNextJson(), false);
+  TEST_EQ(parser.error_.empty(), true);
+}
+
+// Parse JSON with several parsers that share one schema.
+void SharedSchemaTest() {
+  std::string schemafile;
+  std::string jsonfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.fbs", false, &schemafile), true);
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monsterdata_test.golden", false, &jsonfile), true);
+  flatbuffers::Parser schema;
+  const char *include_directories[] = { "tests", nullptr };
+  TEST_EQ(schema.Parse(schemafile.c_str(), include_directories), true);
+
+  // These would typically each live on their own thread.
+  flatbuffers::Parser parser1(&schema);
+  flatbuffers::Parser parser2(&schema);
+  TEST_EQ(parser1.Parse(jsonfile.c_str()), true);
+  parser2.StartJsonStream("{ name: \"A\", hp: 1, hp: 2 }\n");
+  TEST_EQ(parser2.ParseNextJson(), false);
+  TEST_EQ(parser2.error_.find("more than once") != std::string::npos, true);
+  parser2.StartJsonStream("{ name: \"A\", color: Red, hp: 1 }\n");
+  TEST_EQ(parser2.ParseNextJson(), true);
+  TEST_EQ(GetMonster(parser2.builder_.GetBufferPointer())->color(),
+          Color_Red);
+
+  // Text is generated with the shared schema.
+  std::string jsongen;
+  flatbuffers::GeneratorOptions opts;
+  opts.indent_step = 2;
+  GenerateText(schema, parser1.builder_.GetBufferPointer(), opts, &jsongen);
+  TEST_EQ_STR(jsongen.c_str(), jsonfile.c_str());
+
+  // Only data can be parsed this way.
+  TEST_EQ(parser1.Parse("table X { Y:int; }"), false);
+  TEST_EQ(schema.structs_.Lookup("X") == nullptr, true);
+}
+
+void SymbolTableTest() {
+  flatbuffers::DefinitionArena arena;
+  flatbuffers::SymbolTable<flatbuffers::Value> table;
+  for (int i = 0; i < 100; i++) {
+    table.Add("v" + flatbuffers::NumToString(i),
+              arena.New<flatbuffers::Value>());
+  }
+  TEST_EQ(table.HasIndex(), false);
+  table.BuildIndex();
+  TEST_EQ(table.HasIndex(), true);
+  for (int i = 0; i < 100; i++) {
+    TEST_EQ(table.Lookup("v" + flatbuffers::NumToString(i)), table.vec[i]);
+  }
+  TEST_EQ(table.Lookup("v100") == nullptr, true);
+  TEST_EQ(table.Lookup("") == nullptr, true);
+
+  // Adding drops the index, lookups still work.
+  table.Add("w", arena.New<flatbuffers::Value>());
+  TEST_EQ(table.HasIndex(), false);
+  TEST_EQ(table.Lookup("w"), table.vec.back());
+  TEST_EQ(table.Lookup("v42"), table.vec[42]);
+
+  // Parsing builds indices for all definitions.
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse("enum E:byte { A, B } table T { e:E; } root_type T;"
+                       "{ e: B }"), true);
+  TEST_EQ(parser.structs_.Lookup("T")->fields.HasIndex(), true);
+  TEST_EQ(parser.enums_.Lookup("E")->vals.HasIndex(), true);
+  TEST_EQ(parser.Parse("{ f: B }"), false);
+  TEST_EQ(parser.error_.find("unknown field: f") != std::string::npos, true);
+}
+
+void EnumReverseIndexTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse(
+    "enum Dense:short { N = -3, O, P = 2, Q }"
+    "enum Sparse:int { A = -100000, B = 7, C = 1000000 }"
+    "enum Flags:ulong (bit_flags) { F0, F1, F63 = 63 }"
+    "table X {} "
+    "union U { X }"
+    "table T { d:Dense = O; s:Sparse = B; u:U; } root_type T;"), true);
+  auto dense = parser.enums_.Lookup("Dense");
+  auto sparse = parser.enums_.Lookup("Sparse");
+  auto flags = parser.enums_.Lookup("Flags");
+  auto u = parser.enums_.Lookup("U");
+  TEST_EQ(dense->HasReverseIndex(), true);
+  TEST_EQ(sparse->HasReverseIndex(), true);
+  TEST_EQ(flags->HasReverseIndex(), true);
+  TEST_EQ(u->HasReverseIndex(), true);
+
+  // Indexed lookups find the same as scanning.
+  TEST_EQ_STR(dense->ReverseLookup(-3)->name.c_str(), "N");
+  TEST_EQ_STR(dense->ReverseLookup(-2)->name.c_str(), "O");
+  TEST_EQ_STR(dense->ReverseLookup(3)->name.c_str(), "Q");
+  TEST_EQ(dense->ReverseLookup(0) == nullptr, true);
+  TEST_EQ(dense->ReverseLookup(-4) == nullptr, true);
+  TEST_EQ(dense->ReverseLookup(4) == nullptr, true);
+  TEST_EQ_STR(sparse->ReverseLookup(-100000)->name.c_str(), "A");
+  TEST_EQ_STR(sparse->ReverseLookup(7)->name.c_str(), "B");
+  TEST_EQ_STR(sparse->ReverseLookup(1000000)->name.c_str(), "C");
+  TEST_EQ(sparse->ReverseLookup(8) == nullptr, true);
+  TEST_EQ_STR(flags->ReverseLookup(2)->name.c_str(), "F1");
+  TEST_EQ(flags->ReverseLookup(3) == nullptr, true);
+  TEST_EQ(u->ReverseLookup(0) == nullptr, true);
+  TEST_EQ_STR(u->ReverseLookup(0, false)->name.c_str(), "NONE");
+  TEST_EQ_STR(u->ReverseLookup(1)->name.c_str(), "X");
+
+  // Adding a value drops the index, lookups still work. Tried on an enum of
+  // its own, leaving the parser's enums as parsed.
+  flatbuffers::EnumVal o("O", -2), r("R", 100);
+  flatbuffers::EnumDef standalone;
+  standalone.vals.Add(o.name, &o);
+  standalone.BuildReverseIndex();
+  TEST_EQ(standalone.HasReverseIndex(), true);
+  standalone.vals.Add(r.name, &r);
+  TEST_EQ(standalone.HasReverseIndex(), false);
+  TEST_EQ_STR(standalone.ReverseLookup(100)->name.c_str(), "R");
+  standalone.BuildReverseIndex();
+  TEST_EQ(standalone.HasReverseIndex(), true);
+  TEST_EQ_STR(standalone.ReverseLookup(100)->name.c_str(), "R");
+  TEST_EQ_STR(standalone.ReverseLookup(-2)->name.c_str(), "O");
+  TEST_EQ(standalone.ReverseLookup(0) == nullptr, true);
+
+  // Text generation works out a plan per type once, for all documents.
+  auto t = parser.structs_.Lookup("T");
+  TEST_EQ(t->text_plan == nullptr, true);
+  flatbuffers::GeneratorOptions opts;
+  opts.indent_step = -1;
+  std::string text;
+  TEST_EQ(parser.Parse("{ d: P, s: C, u_type: X, u: {} }"), true);
+  GenerateText(parser, parser.builder_.GetBufferPointer(), opts, &text);
+  TEST_EQ_STR(text.c_str(), "{d: P,s: C,u_type: X,u: {}}");
+  auto plan = t->text_plan.get();
+  TEST_NOTNULL(plan);
+  TEST_EQ(parser.Parse("{ d: 1, s: A }"), true);
+  opts.strict_json = true;
+  opts.output_default_scalars_in_json = true;
+  text.clear();
+  GenerateText(parser, parser.builder_.GetBufferPointer(), opts, &text);
+  TEST_EQ_STR(text.c_str(), "{\"d\": 1,\"s\": \"A\",\"u_type\": 0}");
+  TEST_EQ(t->text_plan.get(), plan);
+}
+
+struct ArenaTestObject {
+  ArenaTestObject(int *_destroyed, size_t size)
+    : destroyed(_destroyed), data(size, 'x') {}
+  ~ArenaTestObject() { (*destroyed)++; }
+  int *destroyed;
+  std::string data;
+};
+
+struct ArenaTestBlob { char bytes[100000]; };
+
+void DefinitionArenaTest() {
+  int destroyed = 0;
+  {
+    flatbuffers::DefinitionArena arena;
+    std::vector<ArenaTestObject *> objects;
+    for (int i = 0; i < 10000; i++) {
+      objects.push_back(arena.New<ArenaTestObject>(&destroyed, i % 100));
+      TEST_EQ(reinterpret_cast<size_t>(objects.back()) % sizeof(void *), 0);
+    }
+    // Large enough to get a block of its own.
+    auto big = arena.New<std::vector<int64_t>>();
+    auto blob = arena.New<ArenaTestBlob>();
+    big->push_back(1);
+    blob->bytes[99999] = 'x';
+    for (int i = 0; i < 10000; i++) {
+      TEST_EQ(objects[i]->data.length(), static_cast<size_t>(i % 100));
+    }
+    TEST_EQ(destroyed, 0);
+  }
+  TEST_EQ(destroyed, 10000);
+}
+
+// Strings and whitespace of every length and alignment relative to the
+// blocks the tokenizer scans in.
+void TokenizerTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse("table T { s:string; } root_type T;"), true);
+  for (int len = 0; len < 40; len++) {
+    std::string padding(len % 17, ' ');
+    std::string expected(len, 'a');
+    std::string escaped = expected;
+    if (len) {
+      expected[len / 2] = '\n';
+      escaped.replace(len / 2, 1, "\\n");
+      expected += "\xC3\xA9\"";
+      escaped += "\xC3\xA9\\\"";
+    }
+    auto json = padding + "{\n" + padding + "s:" + padding + "\"" + escaped +
+                "\"\n" + padding + "}";
+    TEST_EQ(parser.Parse(json.c_str()), true);
+    auto root = flatbuffers::GetRoot<flatbuffers::Table>(
+                  parser.builder_.GetBufferPointer());
+    auto s = root->GetPointer<const flatbuffers::String *>(4);
+    TEST_EQ_STR(s->c_str(), expected.c_str());
+
+    // Lines are still counted across whitespace runs.
+    json = padding + "\n\n" + std::string(len, ' ') + "\n" + padding +
+           "{ s: \"" + expected.substr(0, len / 2) + "\t\" }";
+    TEST_EQ(parser.Parse(json.c_str()), false);
+    TEST_EQ(parser.error_.find("4:0: error: illegal character") == 0, true);
+  }
+}
+
+// Parsing carries on right after each include.
+void IncludeTest() {
+  flatbuffers::Parser parser;
+  const char *include_directories[] = { "tests", nullptr };
+  TEST_EQ(parser.Parse("include \"include_test1.fbs\";\n"
+                       "include \"include_test2.fbs\";\n"
+                       "\n"
+                       "table T { e:MyGame.OtherNameSpace.FromInclude; }\n"
+                       "table U { x }\n", include_directories), false);
+  TEST_EQ(parser.error_.find("5:0: error:") == 0, true);
+  TEST_NOTNULL(parser.structs_.Lookup("T"));
+
+  // A file parsed after having been included.
+  TEST_EQ(parser.Parse("table V {}", include_directories,
+                       "tests/include_test2.fbs"), true);
+}
+
+// Source that isn't 0-terminated, with junk after it that must be ignored.
+void ParseLengthTest() {
+  std::string schemafile;
+  std::string jsonfile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.fbs", false, &schemafile), true);
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monsterdata_test.golden", false, &jsonfile), true);
+  flatbuffers::Parser parser;
+  const char *include_directories[] = { "tests", nullptr };
+  auto schema = schemafile + "}}}";
+  TEST_EQ(parser.Parse(schema.c_str(), schemafile.length(),
+                       include_directories), true);
+  auto json = jsonfile + "{ name: \"junk\" }";
+  TEST_EQ(parser.Parse(json.c_str(), jsonfile.length()), true);
+  std::string jsongen;
+  flatbuffers::GeneratorOptions opts;
+  opts.indent_step = 2;
+  GenerateText(parser, parser.builder_.GetBufferPointer(), opts, &jsongen);
+  TEST_EQ_STR(jsongen.c_str(), jsonfile.c_str());
+
+  // Tokens running into the end, in a buffer with nothing after it.
+  const char *tails[] = {
+    "{ name: \"A\", hp: 12", "{ name: \"A", "{ name: \"A\\",
+    "{ name: \"\\u00", "{ na", "{ name: \"A\" } // x", "{ name: \"A\" }\n  "
+  };
+  for (size_t i = 0; i < sizeof(tails) / sizeof(tails[0]); i++) {
+    std::vector<char> buf(tails[i], tails[i] + strlen(tails[i]));
+    TEST_EQ(parser.Parse(&buf[0], buf.size()), i >= 5);
+  }
+  std::string stream = "{ name: \"A\" }\n{ name: \"B\" }";
+  parser.StartJsonStream(stream.c_str(), stream.length() - 1);
+  TEST_EQ(parser.ParseNextJson(), true);
+  TEST_EQ(parser.ParseNextJson(), false);
+  TEST_EQ(parser.error_.empty(), false);
+}
+
+void JsonLinesTest() {
+  std::string schemafile;
+  TEST_EQ(flatbuffers::LoadFile(
+    "tests/monster_test.fbs", false, &schemafile), true);
+  flatbuffers::Parser schema;
+  const char *include_directories[] = { "tests", nullptr };
+  TEST_EQ(schema.Parse(schemafile.c_str(), include_directories), true);
+
+  // Enough lines to be cut into several chunks.
+  const int num_lines = 10000;
+  std::string lines;
+  for (int i = 0; i < num_lines; i++) {
+    lines += "{ name: \"M" + flatbuffers::NumToString(i) + "\", hp: " +
+             flatbuffers::NumToString(i % 30000);
+    // Some with a struct aligned to 16 bytes.
+    if (i % 3 == 0) {
+      lines += ", pos: { x: 1, y: 2, z: 3, test1: 4, test2: Red,"
+               " test3: { a: 5, b: 6 } }";
+    }
+    lines += " }\n";
+  }
+  std::vector<uint8_t> out;
+  auto append = [&](const uint8_t *data, size_t size) {
+    out.insert(out.end(), data, data + size);
+  };
+  std::string error;
+  TEST_EQ(flatbuffers::ParseJsonLines(schema, lines.c_str(), lines.length(),
+                                      nullptr, append, &error, 4), true);
+
+  // Buffers come out size prefixed, in input order, padded to keep their
+  // contents aligned relative to the start of the output.
+  int count = 0;
+  for (size_t pos = 0; pos < out.size(); count++) {
+    TEST_EQ(pos % 16, 0U);
+    auto size = flatbuffers::ReadScalar<flatbuffers::uoffset_t>(&out[pos]);
+    pos += sizeof(flatbuffers::uoffset_t);
+    flatbuffers::Verifier verifier(&out[pos], size);
+    TEST_EQ(VerifyMonsterBuffer(verifier), true);
+    auto monster = GetMonster(&out[pos]);
+    TEST_EQ_STR(monster->name()->c_str(),
+                ("M" + flatbuffers::NumToString(count)).c_str());
+    TEST_EQ(monster->hp(), count % 30000);
+    if (count % 3 == 0) {
+      TEST_EQ((reinterpret_cast<const uint8_t *>(monster->pos()) -
+               out.data()) % 16, 0);
+      TEST_EQ(monster->pos()->test3().b(), 6);
+    }
+    pos += size;
+  }
+  TEST_EQ(count, num_lines);
+
+  // Errors report the line in the whole input, with everything before it
+  // still output.
+  lines.insert(lines.find("\"M9000\""), "x");
+  out.clear();
+  TEST_EQ(flatbuffers::ParseJsonLines(schema, lines.c_str(), lines.length(),
+                                      nullptr, append, &error, 4), false);
+  TEST_EQ(error.find("9001:0: error:") == 0, true);
+  count = 0;
+  for (size_t pos = 0; pos < out.size(); count++) {
+    pos += flatbuffers::ReadScalar<flatbuffers::uoffset_t>(&out[pos]) +
+           sizeof(flatbuffers::uoffset_t);
+  }
+  TEST_EQ(count, 9000);
+}
+
 // Parse a .proto schema, output as .fbs
 void ParseProtoTest() {
   // load the .proto and the golden file from disk
@@ -716,6 +1620,7 @@ void TestError(const char *src, const char *error_substr,
 void ErrorTest() {
   // In order they appear in idl_parser.cpp
   TestError("table X { Y:byte; } root_type X; { Y: 999 }", "bit field");
+  TestError("table X { Y:int; } root_type X; { Y:1.5 }", "type mismatch");
   TestError(".0", "floating point");
   TestError("\"\0", "illegal");
   TestError("\"\\q", "escape code");
@@ -775,6 +1680,72 @@ void ScientificTest() {
           fabs(root[1] - 3.14159) < 0.001, true);
 }
 
+template<typename T> void FloatRoundTrip(T val) {
+  char buf[flatbuffers::kNumToCharsBufferSize + 1];
+  *flatbuffers::NumToChars(val, buf) = 0;
+  const char *end;
+  auto back = flatbuffers::StringToFloat<T>(buf, &end);
+  TEST_EQ(*end, 0);
+  TEST_EQ(memcmp(&back, &val, sizeof(T)), 0);
+}
+
+void NumberConversionTest() {
+  using flatbuffers::NumToString;
+  using flatbuffers::StringToInt;
+  using flatbuffers::StringToFloat;
+
+  // Integers.
+  TEST_EQ_STR(NumToString(0).c_str(), "0");
+  TEST_EQ_STR(NumToString(-7).c_str(), "-7");
+  TEST_EQ_STR(NumToString(static_cast<int8_t>(-128)).c_str(), "-128");
+  TEST_EQ_STR(NumToString(std::numeric_limits<int64_t>::min()).c_str(),
+              "-9223372036854775808");
+  TEST_EQ_STR(NumToString(std::numeric_limits<uint64_t>::max()).c_str(),
+              "18446744073709551615");
+  TEST_EQ(StringToInt("-9223372036854775808"),
+          std::numeric_limits<int64_t>::min());
+  TEST_EQ(static_cast<uint64_t>(StringToInt("18446744073709551615")),
+          std::numeric_limits<uint64_t>::max());
+  TEST_EQ(static_cast<uint64_t>(StringToInt("18446744073709551616")),
+          std::numeric_limits<uint64_t>::max());  // Saturates.
+  TEST_EQ(StringToInt("+42"), 42);
+  TEST_EQ(StringToInt("0x7fFF", 16), 0x7FFF);
+  TEST_EQ(StringToInt("C0de", 16), 0xC0DE);
+
+  // Floats, in the shortest form that reads back exactly, without exponent.
+  TEST_EQ_STR(NumToString(1.0f).c_str(), "1");
+  TEST_EQ_STR(NumToString(0.1f).c_str(), "0.1");
+  TEST_EQ_STR(NumToString(0.1).c_str(), "0.1");
+  TEST_EQ_STR(NumToString(-2.5).c_str(), "-2.5");
+  TEST_EQ_STR(NumToString(3.14159265358979).c_str(), "3.14159265358979");
+  TEST_EQ_STR(NumToString(1e10f).c_str(), "10000000000");
+  TEST_EQ_STR(NumToString(1e-7).c_str(), "0.0000001");
+  TEST_EQ_STR(NumToString(-0.0).c_str(), "-0");
+  TEST_EQ(StringToFloat<double>("0.0314159e+2"), 3.14159);
+  TEST_EQ(StringToFloat<double>("123456789012345678901234567890"),
+          123456789012345678901234567890.0);  // Slow path.
+  TEST_EQ(StringToFloat<float>("7.0385307e-26"), 7.0385307e-26f);
+
+  // A spread of float32 bit patterns, plus the largest and smallest.
+  for (uint64_t bits = 0; bits < (1ULL << 32); bits += 65521) {
+    auto bits32 = static_cast<uint32_t>(bits);
+    float f;
+    memcpy(&f, &bits32, sizeof(f));
+    if (f == f) FloatRoundTrip(f);
+  }
+  FloatRoundTrip(std::numeric_limits<float>::max());
+  FloatRoundTrip(std::numeric_limits<float>::denorm_min());
+  FloatRoundTrip(std::numeric_limits<double>::max());
+  FloatRoundTrip(std::numeric_limits<double>::denorm_min());
+  for (int i = 0; i < 10000; i++) {
+    auto bits = (static_cast<uint64_t>(lcg_rand()) << 33) ^
+                (static_cast<uint64_t>(lcg_rand()) << 16) ^ lcg_rand();
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    if (d == d) FloatRoundTrip(d);
+  }
+}
+
 void EnumStringsTest() {
   flatbuffers::Parser parser1;
   TEST_EQ(parser1.Parse("enum E:byte { A, B, C } table T { F:[E]; }"
@@ -800,6 +1771,442 @@ void UnicodeTest() {
                      "\\u5225\\u30B5\\u30A4\\u30C8\\x01\\x80\"}", true);
 }
 
+void Base64Test() {
+  // Test vectors from RFC 4648.
+  const char *vectors[][2] = {
+    { "", "" }, { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+    { "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" }, { "foobar", "Zm9vYmFy" }
+  };
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+    auto bytes = reinterpret_cast<const uint8_t *>(vectors[i][0]);
+    std::string encoded(flatbuffers::Base64EncodedSize(strlen(vectors[i][0])),
+                        ' ');
+    flatbuffers::Base64Encode(bytes, strlen(vectors[i][0]), &encoded[0]);
+    TEST_EQ_STR(encoded.c_str(), vectors[i][1]);
+  }
+
+  // Random bytes of all lengths make it there and back, padded or not.
+  for (size_t len = 0; len < 100; len++) {
+    std::vector<uint8_t> bytes(len);
+    for (size_t i = 0; i < len; i++) bytes[i] = lcg_rand() & 0xFF;
+    std::string encoded(flatbuffers::Base64EncodedSize(len), ' ');
+    flatbuffers::Base64Encode(bytes.data(), len, &encoded[0]);
+    for (int padded = 0; padded < 2; padded++) {
+      if (!padded) encoded.erase(encoded.find_last_not_of('=') + 1);
+      auto chars = encoded.length();
+      size_t size;
+      TEST_EQ(flatbuffers::Base64DecodedSize(encoded.c_str(), &chars, &size),
+              true);
+      TEST_EQ(size, len);
+      std::vector<uint8_t> decoded(size + 1, 0xAA);
+      TEST_EQ(flatbuffers::Base64Decode(encoded.c_str(), chars,
+                                        decoded.data()), true);
+      TEST_EQ(std::equal(bytes.begin(), bytes.end(), decoded.begin()), true);
+      TEST_EQ(decoded[len], 0xAA);
+    }
+  }
+  size_t chars = 5, size;
+  TEST_EQ(flatbuffers::Base64DecodedSize("Zm9vY", &chars, &size), false);
+  uint8_t buf[3];
+  TEST_EQ(flatbuffers::Base64Decode("Zm9*", 4, buf), false);
+  TEST_EQ(flatbuffers::Base64Decode("Zm\xc3\xa9", 4, buf), false);
+
+  // In JSON, for byte vectors that aren't of an enum type.
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse("enum E:ubyte { A, B }"
+                       "table T { u:[ubyte]; b:[byte]; e:[E]; }"
+                       "root_type T;"
+                       "{ u: \"Zm9vYmFy\", b: \"/w\", e: [ B ] }"), true);
+  std::string jsongen;
+  flatbuffers::GeneratorOptions opts;
+  opts.indent_step = -1;
+  GenerateText(parser, parser.builder_.GetBufferPointer(), opts, &jsongen);
+  TEST_EQ_STR(jsongen.c_str(),
+              "{u: [102,111,111,98,97,114],b: [-1],e: [B]}");
+  opts.base64_byte_vectors = true;
+  jsongen.clear();
+  GenerateText(parser, parser.builder_.GetBufferPointer(), opts, &jsongen);
+  TEST_EQ_STR(jsongen.c_str(), "{u: \"Zm9vYmFy\",b: \"/w==\",e: [B]}");
+  TEST_EQ(parser.Parse("{ u: \"Zm9v!\" }"), false);
+  TEST_EQ(parser.Parse("{ e: \"AA==\" }"), false);
+}
+
+// Text streamed in pieces of bounded size, even for long vectors and strings.
+void StreamTextTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse("table T { v:[int]; s:string; b:[ubyte]; }"
+                       "root_type T;"), true);
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<int> ints(100000);
+  for (size_t i = 0; i < ints.size(); i++) ints[i] = lcg_rand();
+  std::string str(300000, 'x');
+  for (size_t i = 0; i < str.size(); i += 7) str[i] = '\n';
+  std::vector<uint8_t> bytes(200000);
+  for (size_t i = 0; i < bytes.size(); i++) bytes[i] = lcg_rand() & 0xFF;
+  auto v = fbb.CreateVector(ints);
+  auto s = fbb.CreateString(str);
+  auto b = fbb.CreateVector(bytes);
+  auto start = fbb.StartTable();
+  fbb.AddOffset(4, v);
+  fbb.AddOffset(6, s);
+  fbb.AddOffset(8, b);
+  fbb.Finish(flatbuffers::Offset<flatbuffers::Table>(fbb.EndTable(start, 3)));
+
+  flatbuffers::GeneratorOptions opts;
+  opts.base64_byte_vectors = true;
+  std::string text;
+  GenerateText(parser, fbb.GetBufferPointer(), opts, &text);
+  std::string streamed;
+  size_t pieces = 0, largest = 0;
+  TEST_EQ(GenerateText(parser, fbb.GetBufferPointer(), opts,
+                       [&](const char *data, size_t length) {
+    streamed.append(data, length);
+    pieces++;
+    largest = std::max(largest, length);
+    return true;
+  }), true);
+  TEST_EQ(streamed == text, true);
+  TEST_EQ(pieces > 10, true);
+  TEST_EQ(largest < 100000, true);
+
+  // Stops when the sink fails.
+  pieces = 0;
+  TEST_EQ(GenerateText(parser, fbb.GetBufferPointer(), opts,
+                       [&](const char *, size_t) {
+    return ++pieces < 3;
+  }), false);
+  TEST_EQ(pieces, 3);
+
+  auto file = tmpfile();
+  TEST_NOTNULL(file);
+  TEST_EQ(GenerateText(parser, fbb.GetBufferPointer(), opts, file), true);
+  TEST_EQ(static_cast<size_t>(ftell(file)), text.length());
+  fclose(file);
+}
+
+// The way strings were escaped one character at a time, to compare with.
+std::string ReferenceEscape(const std::string &s) {
+  std::string text = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    char c = s[i];
+    switch (c) {
+      case '\n': text += "\\n"; break;
+      case '\t': text += "\\t"; break;
+      case '\r': text += "\\r"; break;
+      case '\b': text += "\\b"; break;
+      case '\f': text += "\\f"; break;
+      case '\"': text += "\\\""; break;
+      case '\\': text += "\\\\"; break;
+      default:
+        if (c >= ' ' && c <= '~') {
+          text += c;
+        } else {
+          const char *utf8 = s.c_str() + i;
+          int ucc = flatbuffers::FromUTF8(&utf8);
+          if (ucc >= 0x80 && ucc <= 0xFFFF) {
+            text += "\\u" + flatbuffers::IntToStringHex(ucc, 4);
+            i = static_cast<size_t>(utf8 - s.c_str() - 1);
+          } else {
+            text += "\\x" + flatbuffers::IntToStringHex(
+                              static_cast<uint8_t>(c), 2);
+          }
+        }
+        break;
+    }
+  }
+  return text + "\"";
+}
+
+// Random strings of plain ASCII, escapes, UTF-8 and invalid bytes, with
+// special characters at every position relative to the blocks scanned.
+void EscapeStringTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse("table T { s:string; } root_type T;"), true);
+  const char *pieces[] = {
+    "a", "plain text ", "\"", "\\", "\n", "\t\r\b\f", "\x01", "\x7F", "~ ",
+    "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xFF", "\xC3"
+  };
+  const int num_pieces = sizeof(pieces) / sizeof(pieces[0]);
+  flatbuffers::GeneratorOptions opts;
+  opts.indent_step = -1;
+  for (int i = 0; i < 1000; i++) {
+    std::string str;
+    auto len = lcg_rand() % 80;
+    while (str.length() < len) {
+      // Mostly plain runs, as in real data.
+      str += lcg_rand() % 3 ? std::string(lcg_rand() % 40, 'x')
+                            : pieces[lcg_rand() % num_pieces];
+    }
+    flatbuffers::FlatBufferBuilder fbb;
+    auto s = fbb.CreateString(str);
+    auto start = fbb.StartTable();
+    fbb.AddOffset(4, s);
+    fbb.Finish(flatbuffers::Offset<flatbuffers::Table>(fbb.EndTable(start,
+                                                                    1)));
+    std::string jsongen;
+    GenerateText(parser, fbb.GetBufferPointer(), opts, &jsongen);
+    TEST_EQ_STR(jsongen.c_str(), ("{s: " + ReferenceEscape(str) + "}").c_str());
+  }
+}
+
+// Vectors of tables and structs flattened to rows of CSV or TSV.
+void CsvTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse(
+    "enum Color:byte { Red, Green }"
+    "struct Vec { x:short; y:short; }"
+    "struct Box { lo:Vec; hi:Vec; }"
+    "table Owner { name:string; age:int = 30; }"
+    "table Item { id:int; name:string; color:Color = Green; ok:bool;"
+    "             pos:Vec; owner:Owner; tags:[string]; w:float = 1.5; }"
+    "table Group { items:[Item]; boxes:[Box]; }"
+    "table Root { group:Group; none:Group; }"
+    "root_type Root;"
+    "{ group: { items: [ { id: 1, name: \"plain\", ok: true,"
+    "                      pos: { x: 1, y: 2 }, owner: { name: \"o\" } },"
+    "                    { id: 2, name: \"a, \\\"b\\\"\\n\", color: Red,"
+    "                      w: 2 } ],"
+    "           boxes: [ { lo: { x: 1, y: 2 }, hi: { x: 3, y: 4 } } ] } }"),
+    true);
+  auto buf = parser.builder_.GetBufferPointer();
+  flatbuffers::GeneratorOptions opts;
+  auto csv = [&](const char *vec, std::vector<std::string> columns,
+                 char separator) {
+    std::string text, error;
+    if (!GenerateCsv(parser, buf, vec, columns, separator, opts,
+                     [&](const char *str, size_t len) {
+                       text.append(str, len);
+                       return true;
+                     }, &error))
+      return "error: " + error;
+    return text;
+  };
+  std::vector<std::string> all;
+  TEST_EQ_STR(csv("group.items", all, ',').c_str(),
+              "id,name,color,ok,pos.x,pos.y,w\n"
+              "1,plain,Green,true,1,2,1.5\n"
+              "2,\"a, \"\"b\"\"\n\",Red,false,,,2\n");
+  TEST_EQ_STR(csv("group.items", { "owner.name", "owner.age", "pos.y" },
+                  '\t').c_str(),
+              "owner.name\towner.age\tpos.y\n"
+              "o\t30\t2\n"
+              "\t\t\n");
+  TEST_EQ_STR(csv("group.boxes", all, ',').c_str(),
+              "lo.x,lo.y,hi.x,hi.y\n1,2,3,4\n");
+  TEST_EQ_STR(csv("none.items", all, ',').c_str(),
+              "id,name,color,ok,pos.x,pos.y,w\n");
+  opts.output_enum_identifiers = false;
+  TEST_EQ_STR(csv("group.items", { "color" }, ',').c_str(), "color\n1\n0\n");
+
+  // Paths that don't fit.
+  TEST_EQ_STR(csv("group", all, ',').c_str(),
+              "error: group isn't a vector of tables or structs");
+  TEST_EQ_STR(csv("group.nope", all, ',').c_str(),
+              "error: unknown field: nope in Group");
+  TEST_EQ_STR(csv("group.items.id", all, ',').c_str(),
+              "error: can't select id from items, it isn't a table or struct");
+  TEST_EQ_STR(csv("group.items", { "tags" }, ',').c_str(),
+              "error: column tags isn't a scalar or string");
+  TEST_EQ_STR(csv("group.items", { "owner" }, ',').c_str(),
+              "error: column owner isn't a scalar or string");
+  TEST_EQ_STR(csv("group.items", { "id.x" }, ',').c_str(),
+              "error: can't select x from id, it isn't a table or struct");
+
+  // Many rows are streamed in pieces of bounded size.
+  std::string json = "{ group: { items: [";
+  for (int i = 0; i < 20000; i++)
+    json += "{ id: " + flatbuffers::NumToString(i) + ", name: \"item\" },";
+  json += "] } }";
+  TEST_EQ(parser.Parse(json.c_str()), true);
+  buf = parser.builder_.GetBufferPointer();
+  std::string text, error;
+  size_t pieces = 0, largest = 0;
+  TEST_EQ(GenerateCsv(parser, buf, "group.items", { "id", "name" }, ',', opts,
+                      [&](const char *str, size_t len) {
+                        text.append(str, len);
+                        pieces++;
+                        largest = std::max(largest, len);
+                        return true;
+                      }, &error), true);
+  TEST_EQ(pieces > 1, true);
+  TEST_EQ(largest < 80000, true);
+  TEST_EQ(text.compare(0, 22, "id,name\n0,item\n1,item\n"), 0);
+  TEST_EQ(text.length() > 20000 * 7, true);
+  size_t calls = 0;
+  TEST_EQ(GenerateCsv(parser, buf, "group.items", all, ',', opts,
+                      [&](const char *, size_t) { return ++calls < 2; },
+                      &error), false);
+  TEST_EQ(calls, 2);
+  TEST_EQ_STR(error.c_str(), "unable to write output");
+}
+
+// Text for just the parts of a buffer selected by a path.
+void TextAtPathTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse(
+    "enum Color:byte { Red, Green }"
+    "struct Vec { x:short; y:short; }"
+    "table Item { id:int; name:string; pos:Vec; tags:[string];"
+    "             kind:Color = Green; }"
+    "table Other { x:int; }"
+    "union Any { Item, Other }"
+    "table Root { items:[Item]; points:[Vec]; nums:[int]; colors:[Color];"
+    "             any:Any; color:Color = Red; more:Item; }"
+    "root_type Root;"
+    "{ items: [ { id: 0, name: \"a\" }, { id: 1, pos: { x: 1, y: 2 } },"
+    "           { id: 2, tags: [ \"x\", \"y\" ] } ],"
+    "  points: [ { x: 3, y: 4 }, { x: 5, y: 6 } ], nums: [ 7, 8, 9 ],"
+    "  colors: [ Green ], any_type: Item, any: { id: 3 }, color: Green }"),
+    true);
+  auto buf = parser.builder_.GetBufferPointer();
+  flatbuffers::GeneratorOptions opts;
+  opts.indent_step = -1;
+  auto at = [&](const char *path) {
+    std::string text, error;
+    if (!GenerateTextAtPath(parser, buf, path, opts, &text, &error))
+      return "error: " + error;
+    return text;
+  };
+  std::string all;
+  GenerateText(parser, buf, opts, &all);
+  TEST_EQ_STR(at("").c_str(), all.c_str());
+  TEST_EQ_STR(at("color").c_str(), "Green");
+  TEST_EQ_STR(at("items[1]").c_str(), "{id: 1,pos: {x: 1,y: 2}}");
+  TEST_EQ_STR(at("items[-1].tags").c_str(), "[\"x\",\"y\"]");
+  TEST_EQ_STR(at("items[2].tags[1]").c_str(), "\"y\"");
+  TEST_EQ_STR(at("items[:].id").c_str(), "[0,1,2]");
+  TEST_EQ_STR(at("items[1:].pos").c_str(), "[{x: 1,y: 2},null]");
+  TEST_EQ_STR(at("items[0:2].pos.y").c_str(), "[null,2]");
+  TEST_EQ_STR(at("items[5:10]").c_str(), "[]");
+  TEST_EQ_STR(at("points[1].y").c_str(), "6");
+  TEST_EQ_STR(at("points[:-1]").c_str(), "[{x: 3,y: 4}]");
+  TEST_EQ_STR(at("nums[1:2]").c_str(), "[8]");
+  TEST_EQ_STR(at("colors[0]").c_str(), "Green");
+  TEST_EQ_STR(at("any.id").c_str(), "3");
+  TEST_EQ_STR(at("more").c_str(), "null");
+  TEST_EQ_STR(at("more.id").c_str(), "null");
+  TEST_EQ_STR(at("items[0].id").c_str(), "0");
+  // Absent enums as for GenerateText(), and union members the rest of the
+  // path doesn't fit as null.
+  TEST_EQ_STR(at("items[0].kind").c_str(), "Green");
+  TEST_EQ_STR(at("any.x").c_str(), "null");
+  opts.output_enum_identifiers = false;
+  TEST_EQ_STR(at("items[0].kind").c_str(), "1");
+  opts.output_enum_identifiers = true;
+
+  // Paths that don't fit, whatever the data holds.
+  TEST_EQ_STR(at("nope").c_str(), "error: unknown field: nope in Root");
+  TEST_EQ_STR(at("nums[3]").c_str(),
+              "error: index 3 out of range for vector of size 3");
+  TEST_EQ_STR(at("nums[-4]").c_str(),
+              "error: index -4 out of range for vector of size 3");
+  TEST_EQ_STR(at("nums.x").c_str(),
+              "error: can't select x from a vector, use [i]");
+  TEST_EQ_STR(at("nums[0].x").c_str(),
+              "error: can't select x from an element of nums, it is a "
+              "scalar or string");
+  TEST_EQ_STR(at("color.x").c_str(),
+              "error: can't select x from color, it is a scalar or string");
+  TEST_EQ_STR(at("more[0]").c_str(),
+              "error: can't index more, it isn't a vector");
+  TEST_EQ_STR(at("items[0][1]").c_str(),
+              "error: can't index an element of items, it isn't a vector");
+  TEST_EQ_STR(at("more.nope").c_str(), "error: unknown field: nope in Item");
+  TEST_EQ_STR(at("items[5:10].nope").c_str(),
+              "error: unknown field: nope in Item");
+  TEST_EQ_STR(at("more.id.x").c_str(),
+              "error: can't select x from id, it is a scalar or string");
+  TEST_EQ_STR(at("any.nope").c_str(), "error: unknown field: nope in Item");
+  TEST_EQ_STR(at("[0]").c_str(),
+              "error: path must start with a field: [0]");
+  TEST_EQ_STR(at("nums[x]").c_str(), "error: invalid index in path: nums[x]");
+  TEST_EQ_STR(at("nums[1:x]").c_str(),
+              "error: invalid index in path: nums[1:x]");
+  TEST_EQ_STR(at("nums[1").c_str(), "error: missing ] in path: nums[1");
+  TEST_EQ_STR(at("items.").c_str(), "error: missing field in path: items.");
+  TEST_EQ_STR(at("items[0]id").c_str(),
+              "error: missing . in path: items[0]id");
+}
+
+// Large vectors of tables generated on several threads, the same as on one.
+void ParallelTextTest() {
+  flatbuffers::Parser parser;
+  TEST_EQ(parser.Parse("table Item { id:int; name:string; items:[Item]; }"
+                       "table Root { items:[Item]; }"
+                       "root_type Root;"), true);
+  flatbuffers::FlatBufferBuilder fbb;
+  auto item = [&](int id, flatbuffers::uoffset_t items) {
+    auto name = fbb.CreateString("item " + flatbuffers::NumToString(id));
+    auto start = fbb.StartTable();
+    fbb.AddElement<int>(4, id, 0);
+    fbb.AddOffset(6, flatbuffers::Offset<void>(name.o));
+    if (items) fbb.AddOffset(8, flatbuffers::Offset<void>(items));
+    return fbb.EndTable(start, 3);
+  };
+  std::vector<flatbuffers::Offset<void>> items;
+  for (int i = 0; i < 5000; i++) {
+    // Some with vectors large enough to split up themselves.
+    flatbuffers::uoffset_t sub_items = 0;
+    if (i % 1000 == 1) {
+      std::vector<flatbuffers::Offset<void>> subs;
+      for (int j = 0; j < 600; j++) subs.push_back(item(j, 0));
+      sub_items = fbb.CreateVector(subs).o;
+    }
+    items.push_back(item(i, sub_items));
+  }
+  auto vec = fbb.CreateVector(items);
+  auto start = fbb.StartTable();
+  fbb.AddOffset(4, vec);
+  fbb.Finish(flatbuffers::Offset<flatbuffers::Table>(fbb.EndTable(start, 1)));
+
+  for (int indent = -1; indent <= 2; indent += 3) {
+    flatbuffers::GeneratorOptions opts;
+    opts.indent_step = indent;
+    std::string serial;
+    GenerateText(parser, fbb.GetBufferPointer(), opts, &serial);
+    opts.num_threads = 4;
+    std::string parallel;
+    GenerateText(parser, fbb.GetBufferPointer(), opts, &parallel);
+    TEST_EQ(parallel == serial, true);
+    std::string streamed;
+    TEST_EQ(GenerateText(parser, fbb.GetBufferPointer(), opts,
+                         [&](const char *data, size_t length) {
+      streamed.append(data, length);
+      return true;
+    }), true);
+    TEST_EQ(streamed == serial, true);
+    int pieces = 0;
+    TEST_EQ(GenerateText(parser, fbb.GetBufferPointer(), opts,
+                         [&](const char *, size_t) {
+      return ++pieces < 2;
+    }), false);
+    TEST_EQ(pieces, 2);
+  }
+
+  // The sink failing right before a large vector, so its workers never get
+  // any of their chunks output, stops them all the same.
+  flatbuffers::Parser parser2;
+  TEST_EQ(parser2.Parse("table E { x:int; } table T { s:string; v:[E]; }"
+                        "root_type T;"), true);
+  flatbuffers::FlatBufferBuilder fbb2;
+  std::vector<flatbuffers::Offset<void>> es;
+  for (int i = 0; i < 5000; i++) {
+    auto e = fbb2.StartTable();
+    fbb2.AddElement<int>(4, i, 0);
+    es.push_back(flatbuffers::Offset<void>(fbb2.EndTable(e, 1)));
+  }
+  auto s = fbb2.CreateString(std::string(65526, 'x'));
+  auto v = fbb2.CreateVector(es);
+  auto t = fbb2.StartTable();
+  fbb2.AddOffset(4, s);
+  fbb2.AddOffset(6, v);
+  fbb2.Finish(flatbuffers::Offset<flatbuffers::Table>(fbb2.EndTable(t, 2)));
+  flatbuffers::GeneratorOptions opts;
+  opts.num_threads = 2;
+  TEST_EQ(GenerateText(parser2, fbb2.GetBufferPointer(), opts,
+                       [](const char *, size_t) { return false; }), false);
+}
+
 int main(int /*argc*/, const char * /*argv*/[]) {
   // Run our various test suites:
 
@@ -813,7 +2220,23 @@ int main(int /*argc*/, const char * /*argv*/[]) {
 
   #ifndef FLATBUFFERS_NO_FILE_TESTS
   ParseAndGenerateTextTest();
+  JsonStreamTest();
+  DeserializeTest();
+  SharedSchemaTest();
+  SchemaCacheTest();
+  SymbolTableTest();
+  EnumReverseIndexTest();
+  DefinitionArenaTest();
+  TokenizerTest();
+  IncludeTest();
+  ParseLengthTest();
+  JsonLinesTest();
   ReflectionTest(flatbuf.get(), rawbuf.length());
+  CopyTableDAGTest();
+  ProjectTableTest(flatbuf.get());
+  PatchTest(flatbuf.get(), rawbuf.length());
+  ColumnsTest();
+  PredicateTest();
   ParseProtoTest();
   #endif
 
@@ -822,8 +2245,15 @@ int main(int /*argc*/, const char * /*argv*/[]) {
 
   ErrorTest();
   ScientificTest();
+  NumberConversionTest();
   EnumStringsTest();
   UnicodeTest();
+  EscapeStringTest();
+  Base64Test();
+  StreamTextTest();
+  ParallelTextTest();
+  TextAtPathTest();
+  CsvTest();
 
   if (!testing_fails) {
     TEST_OUTPUT_LINE("ALL TESTS PASSED");